@@ -1,4 +1,5 @@
 #include <cstdlib>
+#include <cmath>
 #include <iostream>
 #include <chrono>
 
@@ -6,15 +7,336 @@
 #include "svm_data.h"
 
 using namespace std;
+using namespace std::chrono;
+
+// Times svm_predict_dense on the contiguous model
+static void predict_dense(int it) {
+	for (int i = 0; i < it; i++) {
+		svm_node* input = input_fill_random();
+		svm_dense_model* model = dense_model_fill_random();
+		double* x = svm_dense_vector(model, input);
+		high_resolution_clock::time_point t1 = high_resolution_clock::now();
+		svm_predict_dense(model, x);
+		high_resolution_clock::time_point t2 = high_resolution_clock::now();
+		duration<double> time_span = duration_cast<duration<double>>(t2 - t1);
+		cout << CLASS_NUM << ", " << time_span.count() << endl;
+		free(x);
+		svm_free_dense_model(model);
+		destroy_input(input);
+	}
+}
+
+// Times q queries with svm_predict and with svm_predict_ctx, which reuses
+// one context instead of allocating its buffers every time
+static bool predict_ctx(int it, int q) {
+	bool ok = true;
+	for (int i = 0; i < it; i++) {
+		svm_model* model = model_fill_random();
+		svm_node** inputs = (svm_node**) malloc(sizeof(svm_node*) * q);
+		for (int r = 0; r < q; r++)
+			inputs[r] = input_fill_random();
+		svm_predict_context* ctx = svm_create_predict_context(model);
+		double* plain_out = (double*) malloc(sizeof(double) * q);
+		double* ctx_out = (double*) malloc(sizeof(double) * q);
+		high_resolution_clock::time_point t1 = high_resolution_clock::now();
+		for (int r = 0; r < q; r++)
+			plain_out[r] = svm_predict(model, inputs[r]);
+		high_resolution_clock::time_point t2 = high_resolution_clock::now();
+		for (int r = 0; r < q; r++)
+			ctx_out[r] = svm_predict_ctx(model, inputs[r], ctx);
+		high_resolution_clock::time_point t3 = high_resolution_clock::now();
+		for (int r = 0; r < q; r++)
+			ok = ok && plain_out[r] == ctx_out[r];
+		cout << CLASS_NUM << ", " << duration_cast<duration<double>>(t2 - t1).count() << ", "
+			<< duration_cast<duration<double>>(t3 - t2).count() << endl;
+		free(ctx_out);
+		free(plain_out);
+		svm_free_predict_context(ctx);
+		for (int r = 0; r < q; r++)
+			destroy_input(inputs[r]);
+		free(inputs);
+		destroy_model(model);
+	}
+	if (!ok)
+		cout << "context predictions differ from svm_predict" << endl;
+	return ok;
+}
+
+// Times q queries through a context in each vote mode and counts the pairs
+// each skipped. Fails if an early exit changes a label; the DAG only reports
+// how many labels differ from the vote.
+static bool predict_vote(int it, int q) {
+	const char* mode_names[] = { "all", "early-exit", "dag" };
+	bool ok = true;
+	for (int i = 0; i < it; i++) {
+		svm_model* model = model_fill_random();
+		svm_node** inputs = (svm_node**) malloc(sizeof(svm_node*) * q);
+		for (int r = 0; r < q; r++)
+			inputs[r] = input_fill_random();
+		svm_predict_context* ctx = svm_create_predict_context(model);
+		double* all_out = (double*) malloc(sizeof(double) * q);
+		double* out = (double*) malloc(sizeof(double) * q);
+		for (int mode = SVM_VOTE_ALL; mode <= SVM_VOTE_DAG; mode++) {
+			ctx->vote_mode = mode;
+			ctx->pairs_evaluated = 0;
+			ctx->pairs_skipped = 0;
+			high_resolution_clock::time_point t1 = high_resolution_clock::now();
+			for (int r = 0; r < q; r++)
+				out[r] = svm_predict_ctx(model, inputs[r], ctx);
+			high_resolution_clock::time_point t2 = high_resolution_clock::now();
+			int differ = 0;
+			for (int r = 0; r < q; r++) {
+				if (mode == SVM_VOTE_ALL)
+					all_out[r] = out[r];
+				differ += out[r] != all_out[r];
+			}
+			if (mode == SVM_VOTE_EARLY_EXIT && differ > 0)
+				ok = false;
+			cout << CLASS_NUM << ", " << mode_names[mode] << ", "
+				<< duration_cast<duration<double>>(t2 - t1).count() << ", " << ctx->pairs_evaluated << ", "
+				<< ctx->pairs_skipped << ", " << differ << endl;
+		}
+		free(out);
+		free(all_out);
+		svm_free_predict_context(ctx);
+		for (int r = 0; r < q; r++)
+			destroy_input(inputs[r]);
+		free(inputs);
+		destroy_model(model);
+	}
+	if (!ok)
+		cout << "early exit predictions differ from the full vote" << endl;
+	return ok;
+}
+
+// Times svm_predict_dense_parallel against svm_predict_dense
+static bool predict_parallel(int it, int threads) {
+	bool ok = true;
+	svm_pool* pool = svm_pool_create(threads);
+	for (int i = 0; i < it; i++) {
+		svm_node* input = input_fill_random();
+		svm_dense_model* model = dense_model_fill_random();
+		double* x = svm_dense_vector(model, input);
+		high_resolution_clock::time_point t1 = high_resolution_clock::now();
+		double serial = svm_predict_dense(model, x);
+		high_resolution_clock::time_point t2 = high_resolution_clock::now();
+		double parallel = svm_predict_dense_parallel(model, x, pool);
+		high_resolution_clock::time_point t3 = high_resolution_clock::now();
+		ok = ok && serial == parallel;
+		cout << CLASS_NUM << ", " << duration_cast<duration<double>>(t2 - t1).count() << ", "
+			<< duration_cast<duration<double>>(t3 - t2).count() << endl;
+		free(x);
+		svm_free_dense_model(model);
+		destroy_input(input);
+	}
+	if (!ok)
+		cout << "parallel predictions differ from svm_predict_dense" << endl;
+	svm_pool_destroy(pool);
+	return ok;
+}
+
+// Times svm_predict_batch on n inputs against n calls of svm_predict_dense,
+// and svm_predict_batch_parallel on a pool of the given size
+static bool predict_batch(int it, int n, int threads) {
+	svm_pool* pool = svm_pool_create(threads);
+	bool ok = true;
+	for (int i = 0; i < it; i++) {
+		svm_dense_model* model = dense_model_fill_random();
+		svm_node** inputs = (svm_node**) malloc(sizeof(svm_node*) * n);
+		for (int r = 0; r < n; r++)
+			inputs[r] = input_fill_random();
+		double* x = svm_dense_batch(model, inputs, n);
+		double* batch_out = (double*) malloc(sizeof(double) * n);
+		double* single_out = (double*) malloc(sizeof(double) * n);
+		double* parallel_out = (double*) malloc(sizeof(double) * n);
+		high_resolution_clock::time_point t1 = high_resolution_clock::now();
+		svm_predict_batch(model, x, n, batch_out);
+		high_resolution_clock::time_point t2 = high_resolution_clock::now();
+		for (int r = 0; r < n; r++)
+			single_out[r] = svm_predict_dense(model, x + (size_t) r * model->stride);
+		high_resolution_clock::time_point t3 = high_resolution_clock::now();
+		svm_predict_batch_parallel(model, x, n, parallel_out, pool);
+		high_resolution_clock::time_point t4 = high_resolution_clock::now();
+		for (int r = 0; r < n; r++)
+			ok = ok && batch_out[r] == single_out[r] && parallel_out[r] == single_out[r];
+		cout << CLASS_NUM << ", " << duration_cast<duration<double>>(t2 - t1).count() << ", "
+			<< duration_cast<duration<double>>(t3 - t2).count() << ", "
+			<< duration_cast<duration<double>>(t4 - t3).count() << endl;
+		free(parallel_out);
+		free(single_out);
+		free(batch_out);
+		free(x);
+		for (int r = 0; r < n; r++)
+			destroy_input(inputs[r]);
+		free(inputs);
+		svm_free_dense_model(model);
+	}
+	if (!ok)
+		cout << "batch predictions differ from svm_predict_dense" << endl;
+	svm_pool_destroy(pool);
+	return ok;
+}
+
+// Compiles the model into pair weight vectors and times q queries with
+// svm_predict_linear against svm_predict_dense. The decision values of every
+// query are compared with those of svm_predict_dense_ctx; returns false if an
+// error is over the tolerance or the kernel is not linear. Labels may only
+// differ where a decision is within rounding of zero, so they are counted,
+// not checked.
+static bool predict_linear(int it, int q) {
+	const double tolerance = 1e-9;
+	bool ok = true;
+	for (int i = 0; i < it && ok; i++) {
+		svm_dense_model* model = dense_model_fill_random();
+		svm_node** inputs = (svm_node**) malloc(sizeof(svm_node*) * q);
+		for (int r = 0; r < q; r++)
+			inputs[r] = input_fill_random();
+		double* x = svm_dense_batch(model, inputs, q);
+		high_resolution_clock::time_point t1 = high_resolution_clock::now();
+		svm_linear_model* lin = svm_compile_linear(model, 0);
+		high_resolution_clock::time_point t2 = high_resolution_clock::now();
+		if (lin == NULL) {
+			cout << "the model kernel is not linear" << endl;
+			ok = false;
+		} else {
+			svm_predict_context* ctx = svm_create_dense_predict_context(model);
+			svm_predict_context* ref = svm_create_dense_predict_context(model);
+			double* dense_out = (double*) malloc(sizeof(double) * q);
+			double* linear_out = (double*) malloc(sizeof(double) * q);
+			for (int r = 0; r < q; r++)
+				dense_out[r] = svm_predict_dense(model, x + (size_t) r * model->stride);
+			high_resolution_clock::time_point t3 = high_resolution_clock::now();
+			for (int r = 0; r < q; r++)
+				linear_out[r] = svm_predict_linear(lin, x + (size_t) r * model->stride, ctx);
+			high_resolution_clock::time_point t4 = high_resolution_clock::now();
+			int differ = 0;
+			for (int r = 0; r < q; r++)
+				differ += dense_out[r] != linear_out[r];
+			// Every pair is decided both ways, as vote_mode is SVM_VOTE_ALL
+			double err = 0;
+			for (int r = 0; r < q; r++) {
+				svm_predict_linear(lin, x + (size_t) r * model->stride, ctx);
+				svm_predict_dense_ctx(model, x + (size_t) r * model->stride, ref);
+				for (int p = 0; p < lin->nr_pairs; p++) {
+					double a = ctx->dec_values[p];
+					double b = ref->dec_values[p];
+					double e = fabs(a - b) / fmax(1, fabs(b));
+					if (e > err)
+						err = e;
+				}
+			}
+			cout << CLASS_NUM << ", " << (lin->w ? "pairs" : "svs") << ", " << lin->sv_flops << ", "
+				<< lin->pair_flops << ", " << lin->sv_flops / lin->pair_flops << ", " << lin->pair_bytes << ", "
+				<< duration_cast<duration<double>>(t2 - t1).count() << ", "
+				<< duration_cast<duration<double>>(t3 - t2).count() << ", "
+				<< duration_cast<duration<double>>(t4 - t3).count() << ", " << differ << ", " << err << endl;
+			if (err > tolerance) {
+				cout << "  over the tolerance of " << tolerance << endl;
+				ok = false;
+			}
+			free(linear_out);
+			free(dense_out);
+			svm_free_predict_context(ref);
+			svm_free_predict_context(ctx);
+			svm_free_linear_model(lin);
+		}
+		free(x);
+		for (int r = 0; r < q; r++)
+			destroy_input(inputs[r]);
+		free(inputs);
+		svm_free_dense_model(model);
+	}
+	return ok;
+}
+
+// Keeps the timed kernel values from being optimized away
+static volatile double kernel_sink;
+
+// Compares the dense kernels of every instruction set the CPU supports with
+// the sparse k_function, for every kernel type, and times one pass over the
+// SVs with each. Returns false if an error is over the tolerance.
+static bool check_kernels(int it) {
+	const double tolerance = 1e-9;
+	const char* kernel_names[] = { "linear", "poly", "rbf", "sigmoid" };
+	// Small gammas keep exp and tanh away from saturating on these values
+	svm_parameter params[4];
+	for (int k = 0; k < 4; k++) {
+		params[k].kernel_type = k;
+		params[k].degree = 3;
+		params[k].gamma = k == RBF ? 1e-7 : 1e-6;
+		params[k].coef0 = 1;
+	}
+	bool ok = true;
+	cout << "isa, kernel, max relative error, seconds" << endl;
+	for (int i = 0; i < it; i++) {
+		svm_node* input = input_fill_random();
+		svm_model* model = model_fill_random();
+		svm_dense_model* dense = svm_dense_from_model(model);
+		double* x = svm_dense_vector(dense, input);
+		for (int k = 0; k < 4; k++) {
+			for (int level = 0; level < SVM_SIMD_COUNT; level++) {
+				if (!svm_simd_select(level))
+					continue;
+				double err = 0, sink = 0;
+				high_resolution_clock::time_point t1 = high_resolution_clock::now();
+				for (int s = 0; s < dense->l; s++)
+					sink += svm_dense_k_function(x, dense->SV + (size_t) s * dense->stride, dense->stride, &params[k]);
+				high_resolution_clock::time_point t2 = high_resolution_clock::now();
+				kernel_sink = sink;
+				for (int s = 0; s < dense->l; s++) {
+					double a = svm_dense_k_function(x, dense->SV + (size_t) s * dense->stride, dense->stride, &params[k]);
+					double b = svm_k_function(input, model->SV[s], &params[k]);
+					double e = fabs(a - b) / fmax(1, fabs(b));
+					if (e > err)
+						err = e;
+				}
+				duration<double> time_span = duration_cast<duration<double>>(t2 - t1);
+				cout << svm_simd_name(level) << ", " << kernel_names[k] << ", " << err << ", "
+					<< time_span.count() << endl;
+				if (err > tolerance) {
+					cout << "  over the tolerance of " << tolerance << endl;
+					ok = false;
+				}
+			}
+		}
+		svm_simd_select(svm_simd_best());
+		free(x);
+		svm_free_dense_model(dense);
+		destroy_model(model);
+		destroy_input(input);
+	}
+	return ok;
+}
 
 int main(int argc, char** argv) {
 	if (argc < 2) {
 		cout << "check input arguments" << endl;
-		return EXIT_FAILURE;	
+		cout << "usage: " << argv[0] << " <iterations> [dense [scalar|sse2|avx2|avx512] | check | batch [inputs [threads]] | parallel [threads] | ctx [queries] | linear [queries] | vote [queries]]" << endl;
+		return EXIT_FAILURE;
    }
-   using namespace std::chrono;
 
    int it = stoi(argv[1]);
+   string mode = argc > 2 ? argv[2] : "";
+   if (mode == "dense" && argc > 3 && !svm_simd_select(svm_simd_find(argv[3]))) {
+      cout << argv[3] << " is not supported" << endl;
+      return EXIT_FAILURE;
+   }
+   if (mode == "batch")
+      return predict_batch(it, argc > 3 ? stoi(argv[3]) : 64, argc > 4 ? stoi(argv[4]) : 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+   if (mode == "ctx")
+      return predict_ctx(it, argc > 3 ? stoi(argv[3]) : 64) ? EXIT_SUCCESS : EXIT_FAILURE;
+   if (mode == "vote")
+      return predict_vote(it, argc > 3 ? stoi(argv[3]) : 64) ? EXIT_SUCCESS : EXIT_FAILURE;
+   if (mode == "linear")
+      return predict_linear(it, argc > 3 ? stoi(argv[3]) : 64) ? EXIT_SUCCESS : EXIT_FAILURE;
+   if (mode == "parallel")
+      return predict_parallel(it, argc > 3 ? stoi(argv[3]) : 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+   if (mode == "dense") {
+      predict_dense(it);
+      return EXIT_SUCCESS;
+   }
+   if (mode == "check")
+      return check_kernels(it) ? EXIT_SUCCESS : EXIT_FAILURE;
    // random iteration
    for (int i = 0; i < it; i++) {
       // cout << "filling input" << endl;
@@ -1,4 +1,5 @@
 #include "svm.h"
+#include "svm_vote.h"
 #include <stdlib.h>
 #include <math.h>
 #include <ctype.h>
@@ -95,11 +96,18 @@ double k_function(const svm_node *x, const svm_node *y,
 	}
 }
 
-double svm_predict_values(const svm_model *model, const svm_node *x, double* dec_values) {
+double svm_k_function(const svm_node *x, const svm_node *y, const svm_parameter *param) {
+	return k_function(x,y,*param);
+}
+
+// kvalue, start and vote are workspace of l, nr_class and nr_class entries,
+// with start already holding the first SV of each class. The number of pairs
+// decided and skipped are added to evaluated and skipped, if not NULL.
+static double predict_values(const svm_model *model, const svm_node *x, double* dec_values,
+			     double *kvalue, const int *start, int *vote,
+			     int vote_mode, unsigned long *evaluated, unsigned long *skipped) {
 	int i;
-	if(model->param.svm_type == ONE_CLASS ||
-	   model->param.svm_type == EPSILON_SVR ||
-	   model->param.svm_type == NU_SVR)
+	if(one_decision(model))
 	{
 		double *sv_coef = model->sv_coef[0];
 		double sum = 0;
@@ -115,61 +123,27 @@ double svm_predict_values(const svm_model *model, const svm_node *x, double* dec
 	}
 	else
 	{
-		int nr_class = model->nr_class;
-		int l = model->l;
-
-		double *kvalue = Malloc(double,l);
-		for(i=0;i<l;i++)
+		for(i=0;i<model->l;i++)
 			kvalue[i] = k_function(x,model->SV[i],model->param);
-
-		int *start = Malloc(int,nr_class);
-		start[0] = 0;
-		for(i=1;i<nr_class;i++)
-			start[i] = start[i-1]+model->nSV[i-1];
-
-		int *vote = Malloc(int,nr_class);
-		for(i=0;i<nr_class;i++)
-			vote[i] = 0;
-
-		int p=0;
-		for(i=0;i<nr_class;i++)
-			for(int j=i+1;j<nr_class;j++)
-			{
-				double sum = 0;
-				int si = start[i];
-				int sj = start[j];
-				int ci = model->nSV[i];
-				int cj = model->nSV[j];
-
-				int k;
-				double *coef1 = model->sv_coef[j-1];
-				double *coef2 = model->sv_coef[i];
-				for(k=0;k<ci;k++)
-					sum += coef1[si+k] * kvalue[si+k];
-				for(k=0;k<cj;k++)
-					sum += coef2[sj+k] * kvalue[sj+k];
-				sum -= model->rho[p];
-				dec_values[p] = sum;
-
-				if(dec_values[p] > 0)
-					++vote[i];
-				else
-					++vote[j];
-				p++;
-			}
-
-		int vote_max_idx = 0;
-		for(i=1;i<nr_class;i++)
-			if(vote[i] > vote[vote_max_idx])
-				vote_max_idx = i;
-
-		free(kvalue);
-		free(start);
-		free(vote);
-		return model->label[vote_max_idx];
+		return vote_pairs(model, kvalue, start, vote, dec_values, vote_mode, evaluated, skipped);
 	}
 }
 
+double svm_predict_values(const svm_model *model, const svm_node *x, double* dec_values) {
+	if(one_decision(model))
+		return predict_values(model, x, dec_values, NULL, NULL, NULL, SVM_VOTE_ALL, NULL, NULL);
+	int nr_class = model->nr_class;
+	double *kvalue = Malloc(double,model->l);
+	int *start = Malloc(int,nr_class);
+	class_starts(model->nSV, nr_class, start);
+	int *vote = Malloc(int,nr_class);
+	double pred_result = predict_values(model, x, dec_values, kvalue, start, vote, SVM_VOTE_ALL, NULL, NULL);
+	free(kvalue);
+	free(start);
+	free(vote);
+	return pred_result;
+}
+
 double svm_predict(const svm_model *model, const svm_node *x) {
 	int nr_class = model->nr_class;
 	double *dec_values;
@@ -182,4 +156,40 @@ double svm_predict(const svm_model *model, const svm_node *x) {
 	double pred_result = svm_predict_values(model, x, dec_values);
 	free(dec_values);
 	return pred_result;
-}
\ No newline at end of file
+}
+
+svm_predict_context *svm_create_predict_context(const svm_model *model) {
+	svm_predict_context *ctx = (svm_predict_context *)calloc(1, sizeof(svm_predict_context));
+	if(ctx == NULL)
+		return NULL;
+	int nr_class = model->nr_class;
+	ctx->nr_class = nr_class;
+	ctx->l = model->l;
+	ctx->kvalue = Malloc(double,model->l > 0 ? model->l : 1);
+	ctx->start = Malloc(int,nr_class);
+	ctx->vote = Malloc(int,nr_class);
+	ctx->dec_values = Malloc(double,one_decision(model) ? 1 : nr_class*(nr_class-1)/2 + 1);
+	if(ctx->kvalue == NULL || ctx->start == NULL || ctx->vote == NULL || ctx->dec_values == NULL)
+	{
+		svm_free_predict_context(ctx);
+		return NULL;
+	}
+	if(!one_decision(model))
+		class_starts(model->nSV, nr_class, ctx->start);
+	return ctx;
+}
+
+void svm_free_predict_context(svm_predict_context *ctx) {
+	if(ctx == NULL)
+		return;
+	free(ctx->kvalue);
+	free(ctx->start);
+	free(ctx->vote);
+	free(ctx->dec_values);
+	free(ctx);
+}
+
+double svm_predict_ctx(const svm_model *model, const svm_node *x, svm_predict_context *ctx) {
+	return predict_values(model, x, ctx->dec_values, ctx->kvalue, ctx->start, ctx->vote,
+			      ctx->vote_mode, &ctx->pairs_evaluated, &ctx->pairs_skipped);
+}
@@ -1,6 +1,8 @@
 #ifndef _SVM_H_
 #define _SVM_H_
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -56,6 +58,142 @@ typedef struct {
 
 double svm_predict(const svm_model *model, const svm_node *x);
 
+/* How the class pairs of a prediction are visited. SVM_VOTE_EARLY_EXIT
+   checks after every pair whether any class could still overtake the winner
+   by winning all of its pairs left, stops once none can, and gives the same
+   label as SVM_VOTE_ALL. SVM_VOTE_DAG walks a decision DAG:
+   each of its nr_class-1 decisions eliminates one class, and the label may
+   differ from the vote. Decision values of skipped pairs are left as they
+   were. */
+enum { SVM_VOTE_ALL, SVM_VOTE_EARLY_EXIT, SVM_VOTE_DAG };	/* vote_mode */
+
+/* Buffers for one prediction at a time, sized once from a model and reused,
+   so predicting with it does no heap allocation. Not thread safe: use one
+   context per thread. */
+typedef struct {
+	int nr_class;
+	int l;
+	double *kvalue;		/* kvalue[l] */
+	int *start;		/* first SV of each class (start[nr_class]) */
+	int *vote;		/* vote[nr_class] */
+	double *dec_values;	/* decision values of the last prediction */
+	int vote_mode;		/* SVM_VOTE_ALL unless set */
+	unsigned long pairs_evaluated;	/* class pairs decided so far */
+	unsigned long pairs_skipped;	/* and skipped by vote_mode */
+} svm_predict_context;
+
+svm_predict_context *svm_create_predict_context(const svm_model *model);
+void svm_free_predict_context(svm_predict_context *ctx);
+/* Same as svm_predict, with the buffers and vote_mode of ctx */
+double svm_predict_ctx(const svm_model *model, const svm_node *x, svm_predict_context *ctx);
+
+/* The kernel of param between two sparse vectors */
+double svm_k_function(const svm_node *x, const svm_node *y, const svm_parameter *param);
+
+/* Bytes every dense row starts on, the widest SIMD register */
+#define SVM_DENSE_ALIGN 64
+
+/* A model with all SVs in one row-major matrix, for the dense predict path.
+   Feature i of a vector (svm_node index i+1) is column i, and every row is
+   padded with zeros to a multiple of SVM_DENSE_ALIGN bytes. */
+typedef struct {
+	svm_parameter param;
+	int nr_class;
+	int l;
+	int dim;		/* features, the largest svm_node index */
+	int stride;		/* doubles per row, dim rounded up */
+	double *SV;		/* SV[i*stride+j], aligned */
+	double *sv_coef;	/* sv_coef[k*l+i] is sv_coef[k][i] of the svm_model */
+	double *rho;
+	int *label;
+	int *nSV;
+} svm_dense_model;
+
+/* Copies a model into the dense layout. Returns NULL if out of memory or for
+   the PRECOMPUTED kernel. */
+svm_dense_model *svm_dense_from_model(const svm_model *model);
+void svm_free_dense_model(svm_dense_model *model);
+/* Allocates an aligned, zero padded vector of model->stride doubles holding x */
+double *svm_dense_vector(const svm_dense_model *model, const svm_node *x);
+/* Same as svm_predict, for a vector made by svm_dense_vector */
+double svm_predict_dense(const svm_dense_model *model, const double *x);
+svm_predict_context *svm_create_dense_predict_context(const svm_dense_model *model);
+/* Same as svm_predict_dense, with the buffers and vote_mode of ctx */
+double svm_predict_dense_ctx(const svm_dense_model *model, const double *x, svm_predict_context *ctx);
+
+/* Inputs whose kernel values are computed together by svm_predict_batch, and
+   SVs per cache block: 64 rows of 128 doubles take 64KB */
+#define SVM_BATCH_ROWS 16
+#define SVM_BATCH_SVS 64
+
+/* Allocates an aligned n x model->stride matrix, one dense row per input */
+double *svm_dense_batch(const svm_dense_model *model, const svm_node *const *x, int n);
+/* Predicts the n rows of inputs (see svm_dense_batch) into out. The kernel
+   matrix is computed in blocks, like a matrix multiply, so every SV is read
+   from memory once per SVM_BATCH_ROWS inputs rather than once per input. */
+void svm_predict_batch(const svm_dense_model *model, const double *inputs, int n, double *out);
+
+/* A LINEAR model compiled into one weight vector per class pair: the
+   decision of a pair is the dot product of the input with the sum of the
+   SVs of both classes weighted by their coefficients, minus rho. Per-class
+   partial vectors (one per class and coefficient row) are not built, since
+   they take twice as many dot products as the pair vectors. */
+typedef struct {
+	const svm_dense_model *model;	/* not owned */
+	int nr_pairs;		/* class pairs, 1 for ONE_CLASS and regression */
+	double *w;		/* w[p*model->stride+j], aligned; NULL if the SVs are cheaper */
+	double sv_flops;	/* expected flops of one prediction over the SVs */
+	double pair_flops;	/* and over the pair weight vectors */
+	double pair_bytes;	/* size of the pair weight vectors */
+} svm_linear_model;
+
+/* Largest pair weight matrix svm_compile_linear builds by default */
+#define SVM_LINEAR_MAX_BYTES (1UL << 30)
+
+/* Compiles a LINEAR model. The pair vectors are built only if they take
+   fewer flops than the SVs and at most max_bytes (0 for the default).
+   Returns NULL for other kernels. */
+svm_linear_model *svm_compile_linear(const svm_dense_model *model, size_t max_bytes);
+void svm_free_linear_model(svm_linear_model *lin);
+/* Same as svm_predict_dense_ctx, through the representation that was
+   picked, with ctx made by svm_create_dense_predict_context for lin->model.
+   The pair vectors always decide every pair. */
+double svm_predict_linear(const svm_linear_model *lin, const double *x, svm_predict_context *ctx);
+
+/* A pool of persistent threads for the parallel predict paths */
+typedef struct svm_pool svm_pool;
+/* threads counts the calling thread; 0 for one per core */
+svm_pool *svm_pool_create(int threads);
+void svm_pool_destroy(svm_pool *pool);
+int svm_pool_size(const svm_pool *pool);
+/* Runs fn(arg, task) for every task in [0, tasks) on the pool and the
+   calling thread, and returns when all are done */
+void svm_pool_run(svm_pool *pool, void (*fn)(void *, int), void *arg, int tasks);
+/* Same as svm_predict_dense, with the kernel values split across the pool by
+   SV ranges and the votes by class pair ranges */
+double svm_predict_dense_parallel(const svm_dense_model *model, const double *x, svm_pool *pool);
+/* Same as svm_predict_batch, with the inputs split across the pool */
+void svm_predict_batch_parallel(const svm_dense_model *model, const double *inputs, int n, double *out,
+				svm_pool *pool);
+
+/* Dense kernels. The instruction set is picked at startup from CPUID, the
+   best of the ones below that the CPU supports, and can be changed with
+   svm_simd_select (e.g. to compare against scalar). */
+enum { SVM_SIMD_SCALAR, SVM_SIMD_SSE2, SVM_SIMD_AVX2, SVM_SIMD_AVX512, SVM_SIMD_COUNT };
+int svm_simd_supported(int level);
+int svm_simd_best();
+/* Returns 0 if the CPU does not support level */
+int svm_simd_select(int level);
+int svm_simd_level();
+const char *svm_simd_name(int level);
+/* Returns -1 for an unknown name */
+int svm_simd_find(const char *name);
+/* The kernel of param between two dense vectors of n doubles */
+double svm_dense_k_function(const double *x, const double *y, int n, const svm_parameter *param);
+double svm_dense_dot(const double *x, const double *y, int n);
+/* Squared euclidean distance */
+double svm_dense_dist2(const double *x, const double *y, int n);
+
 #ifdef __cplusplus
 }
 #endif
@@ -27,7 +27,7 @@ svm_model* model_fill_random() {
 			return NULL;
 
 		for (int j = 0; j < input_size; j++) {
-			m->SV[i][j].index = 0;
+			m->SV[i][j].index = j + 1;
 			m->SV[i][j].value = fRand(-200, 200);
 		}
 		m->SV[i][input_size-1].index = -1;
@@ -72,14 +72,63 @@ svm_model* model_fill_random() {
     return m;
 }
 
+// Same model as model_fill_random, built straight into the dense layout
+svm_dense_model* dense_model_fill_random() {
+	svm_dense_model* m = (svm_dense_model*) calloc(1, sizeof(svm_dense_model));
+	if (m == NULL)
+		return NULL;
+	m->param.svm_type = C_SVC;
+	m->param.kernel_type = LINEAR;
+	m->nr_class = class_num;
+	m->l = sv_n;
+	m->dim = input_size - 1;
+	int per_align = SVM_DENSE_ALIGN / sizeof(double);
+	m->stride = (m->dim + per_align - 1) / per_align * per_align;
+
+	// one aligned block for all support vectors, padding left at zero
+	void* sv;
+	if (posix_memalign(&sv, SVM_DENSE_ALIGN, sizeof(double) * sv_n * m->stride) != 0) {
+		free(m);
+		return NULL;
+	}
+	m->SV = (double*) sv;
+	for (int i = 0; i < sv_n; i++) {
+		double* row = m->SV + (size_t) i * m->stride;
+		for (int j = 0; j < m->stride; j++)
+			row[j] = j < m->dim ? fRand(-200, 200) : 0;
+		// model_fill_random draws a value for the terminator too
+		fRand(-200, 200);
+	}
+
+	m->sv_coef = (double*) malloc(sizeof(double) * (class_num-1) * sv_n);
+	int rho_size = ((class_num-1) * class_num / 2);
+	m->rho = (double*) malloc(sizeof(double) * rho_size);
+	m->label = (int*) malloc(sizeof(int) * class_num);
+	m->nSV = (int*) malloc(sizeof(int) * class_num);
+	if (m->sv_coef == NULL || m->rho == NULL || m->label == NULL || m->nSV == NULL) {
+		svm_free_dense_model(m);
+		return NULL;
+	}
+	for (int i = 0; i < (class_num-1) * sv_n; i++)
+		m->sv_coef[i] = fRand(-400, 400);
+	for (int i = 0; i < rho_size; i++)
+		m->rho[i] = fRand(-500, 500);
+	for (int i = 0; i < class_num; i++) {
+		m->label[i] = i;
+		m->nSV[i] = sv_n / class_num;
+	}
+	return m;
+}
+
 svm_node* input_fill_random() {
 	svm_node* n = (svm_node*) malloc(sizeof(svm_node) * input_size);
 	if (n == NULL)
 		return NULL;
 	for (int i = 0; i < input_size; i++) {
-		n[i].index = 0;
+		n[i].index = i + 1;
 		n[i].value = fRand(-600, 600);
 	}
+	n[input_size-1].index = -1;
 	return n;
 }
 
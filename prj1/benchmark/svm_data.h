@@ -4,6 +4,7 @@
 #include "svm.h"
 
 svm_model* model_fill_random();
+svm_dense_model* dense_model_fill_random();
 svm_node* input_fill_random();
 void destroy_model(svm_model* m);
 void destroy_input(svm_node* n);
@@ -0,0 +1,242 @@
+#include "svm.h"
+#include "svm_vote.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define Malloc(type,n) (type *)malloc((n)*sizeof(type))
+
+static double *aligned_zeros(size_t n) {
+	void *p;
+	if(posix_memalign(&p, SVM_DENSE_ALIGN, n*sizeof(double)) != 0)
+		return NULL;
+	memset(p, 0, n*sizeof(double));
+	return (double *)p;
+}
+
+static inline double powi(double base, int times) {
+	double tmp = base, ret = 1.0;
+
+	for(int t=times; t>0; t/=2)
+	{
+		if(t%2==1) ret*=tmp;
+		tmp = tmp * tmp;
+	}
+	return ret;
+}
+
+/* The padding is zero in both vectors, so it adds nothing */
+double svm_dense_k_function(const double *x, const double *y, int n,
+			  const svm_parameter *p) {
+	const svm_parameter& param = *p;
+	switch(param.kernel_type)
+	{
+		case LINEAR:
+			return svm_dense_dot(x,y,n);
+		case POLY:
+			return powi(param.gamma*svm_dense_dot(x,y,n)+param.coef0,param.degree);
+		case RBF:
+			return exp(-param.gamma*svm_dense_dist2(x,y,n));
+		case SIGMOID:
+			return tanh(param.gamma*svm_dense_dot(x,y,n)+param.coef0);
+		default:
+			return 0;  // Not supported by svm_dense_from_model
+	}
+}
+
+svm_dense_model *svm_dense_from_model(const svm_model *model) {
+	if(model->param.kernel_type == PRECOMPUTED)
+		return NULL;
+	int nr_class = model->nr_class;
+	int l = model->l;
+	int nr_coef = nr_class-1;
+	if(model->param.svm_type == ONE_CLASS ||
+	   model->param.svm_type == EPSILON_SVR ||
+	   model->param.svm_type == NU_SVR)
+		nr_coef = 1;
+	int nr_rho = nr_coef == 1 ? 1 : nr_class*(nr_class-1)/2;
+
+	svm_dense_model *m = Malloc(svm_dense_model,1);
+	if(m == NULL)
+		return NULL;
+	memset(m, 0, sizeof(*m));
+	m->param = model->param;
+	m->nr_class = nr_class;
+	m->l = l;
+	for(int i=0;i<l;i++)
+		for(const svm_node *p = model->SV[i]; p->index != -1; p++)
+			if(p->index > m->dim)
+				m->dim = p->index;
+	int per_align = SVM_DENSE_ALIGN / sizeof(double);
+	m->stride = (m->dim + per_align - 1) / per_align * per_align;
+
+	m->SV = aligned_zeros((size_t)l * m->stride);
+	m->sv_coef = Malloc(double,(size_t)nr_coef * l);
+	m->rho = Malloc(double,nr_rho);
+	m->label = Malloc(int,nr_class);
+	m->nSV = Malloc(int,nr_class);
+	if((l > 0 && m->SV == NULL) || m->sv_coef == NULL || m->rho == NULL ||
+	   m->label == NULL || m->nSV == NULL)
+	{
+		svm_free_dense_model(m);
+		return NULL;
+	}
+	for(int i=0;i<l;i++)
+	{
+		double *row = m->SV + (size_t)i * m->stride;
+		for(const svm_node *p = model->SV[i]; p->index != -1; p++)
+			if(p->index > 0)
+				row[p->index-1] = p->value;
+	}
+	for(int k=0;k<nr_coef;k++)
+		memcpy(m->sv_coef + (size_t)k * l, model->sv_coef[k], l*sizeof(double));
+	memcpy(m->rho, model->rho, nr_rho*sizeof(double));
+	if(model->label)
+		memcpy(m->label, model->label, nr_class*sizeof(int));
+	if(model->nSV)
+		memcpy(m->nSV, model->nSV, nr_class*sizeof(int));
+	return m;
+}
+
+void svm_free_dense_model(svm_dense_model *model) {
+	if(model == NULL)
+		return;
+	free(model->SV);
+	free(model->sv_coef);
+	free(model->rho);
+	free(model->label);
+	free(model->nSV);
+	free(model);
+}
+
+double *svm_dense_vector(const svm_dense_model *model, const svm_node *x) {
+	double *v = aligned_zeros(model->stride);
+	if(v == NULL)
+		return NULL;
+	// Features no SV has are dropped
+	for(; x->index != -1; x++)
+		if(x->index > 0 && x->index <= model->dim)
+			v[x->index-1] = x->value;
+	return v;
+}
+
+// Decision from the kernel values of one input against every SV. start and
+// vote are workspace of nr_class entries, as for vote_pairs.
+static double dense_decide(const svm_dense_model *model, const double *kvalue,
+			   const int *start, int *vote, double *dec_values,
+			   int vote_mode, unsigned long *evaluated, unsigned long *skipped) {
+	if(one_decision(model))
+	{
+		double sum = 0;
+		for(int i=0;i<model->l;i++)
+			sum += model->sv_coef[i] * kvalue[i];
+		sum -= model->rho[0];
+		if(dec_values)
+			*dec_values = sum;
+		if(model->param.svm_type == ONE_CLASS)
+			return (sum>0)?1:-1;
+		else
+			return sum;
+	}
+	return vote_pairs(model, kvalue, start, vote, dec_values, vote_mode, evaluated, skipped);
+}
+
+// dense_decide with its own workspace
+static double dense_decide_alloc(const svm_dense_model *model, const double *kvalue) {
+	if(one_decision(model))
+		return dense_decide(model, kvalue, NULL, NULL, NULL, SVM_VOTE_ALL, NULL, NULL);
+	int *start = Malloc(int,model->nr_class);
+	int *vote = Malloc(int,model->nr_class);
+	class_starts(model->nSV, model->nr_class, start);
+	double ret = dense_decide(model, kvalue, start, vote, NULL, SVM_VOTE_ALL, NULL, NULL);
+	free(start);
+	free(vote);
+	return ret;
+}
+
+double svm_predict_dense(const svm_dense_model *model, const double *x) {
+	int l = model->l;
+	int n = model->stride;
+	// The SVs are read in order, one row after the other
+	double *kvalue = Malloc(double,l);
+	for(int i=0;i<l;i++)
+		kvalue[i] = svm_dense_k_function(x,model->SV+(size_t)i*n,n,&model->param);
+	double ret = dense_decide_alloc(model, kvalue);
+	free(kvalue);
+	return ret;
+}
+
+svm_predict_context *svm_create_dense_predict_context(const svm_dense_model *model) {
+	svm_predict_context *ctx = (svm_predict_context *)calloc(1, sizeof(svm_predict_context));
+	if(ctx == NULL)
+		return NULL;
+	int nr_class = model->nr_class;
+	ctx->nr_class = nr_class;
+	ctx->l = model->l;
+	ctx->kvalue = Malloc(double,model->l > 0 ? model->l : 1);
+	ctx->start = Malloc(int,nr_class);
+	ctx->vote = Malloc(int,nr_class);
+	ctx->dec_values = Malloc(double,one_decision(model) ? 1 : nr_class*(nr_class-1)/2 + 1);
+	if(ctx->kvalue == NULL || ctx->start == NULL || ctx->vote == NULL || ctx->dec_values == NULL)
+	{
+		svm_free_predict_context(ctx);
+		return NULL;
+	}
+	if(!one_decision(model))
+		class_starts(model->nSV, nr_class, ctx->start);
+	return ctx;
+}
+
+double svm_predict_dense_ctx(const svm_dense_model *model, const double *x, svm_predict_context *ctx) {
+	int n = model->stride;
+	for(int i=0;i<model->l;i++)
+		ctx->kvalue[i] = svm_dense_k_function(x,model->SV+(size_t)i*n,n,&model->param);
+	return dense_decide(model, ctx->kvalue, ctx->start, ctx->vote, ctx->dec_values,
+			    ctx->vote_mode, &ctx->pairs_evaluated, &ctx->pairs_skipped);
+}
+
+double *svm_dense_batch(const svm_dense_model *model, const svm_node *const *x, int n) {
+	double *v = aligned_zeros((size_t)n * model->stride);
+	if(v == NULL)
+		return NULL;
+	for(int r=0;r<n;r++)
+	{
+		double *row = v + (size_t)r * model->stride;
+		for(const svm_node *p = x[r]; p->index != -1; p++)
+			if(p->index > 0 && p->index <= model->dim)
+				row[p->index-1] = p->value;
+	}
+	return v;
+}
+
+void svm_predict_batch(const svm_dense_model *model, const double *inputs, int n, double *out) {
+	int l = model->l;
+	int stride = model->stride;
+	double *kvalue = Malloc(double,(size_t)SVM_BATCH_ROWS * l);
+	int *start = Malloc(int,model->nr_class);
+	int *vote = Malloc(int,model->nr_class);
+	if(!one_decision(model))
+		class_starts(model->nSV, model->nr_class, start);
+	for(int r0=0;r0<n;r0+=SVM_BATCH_ROWS)
+	{
+		int rows = n-r0 < SVM_BATCH_ROWS ? n-r0 : SVM_BATCH_ROWS;
+		// Kernel matrix of these rows: each block of SVs is loaded once and
+		// stays in cache while every row of the block goes over it
+		for(int s0=0;s0<l;s0+=SVM_BATCH_SVS)
+		{
+			int s1 = l-s0 < SVM_BATCH_SVS ? l : s0+SVM_BATCH_SVS;
+			for(int r=0;r<rows;r++)
+			{
+				const double *x = inputs + (size_t)(r0+r) * stride;
+				double *k = kvalue + (size_t)r * l;
+				for(int s=s0;s<s1;s++)
+					k[s] = svm_dense_k_function(x,model->SV+(size_t)s*stride,stride,&model->param);
+			}
+		}
+		for(int r=0;r<rows;r++)
+			out[r0+r] = dense_decide(model, kvalue + (size_t)r * l, start, vote, NULL, SVM_VOTE_ALL, NULL, NULL);
+	}
+	free(kvalue);
+	free(start);
+	free(vote);
+}
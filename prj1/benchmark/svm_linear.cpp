@@ -0,0 +1,121 @@
+#include "svm.h"
+#include "svm_vote.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define Malloc(type,n) (type *)malloc((n)*sizeof(type))
+
+// With a linear kernel sum(coef[s] * (x . SV[s])) is x . sum(coef[s] * SV[s]),
+// so the SVs of a decision fold into one vector ahead of time and a
+// prediction takes one dot product per decision instead of one per SV.
+
+// w += c * SV[s] for the n SVs from s0
+static void add_svs(const svm_dense_model *model, const double *coef, int s0, int n, double *w) {
+	int stride = model->stride;
+	for(int s=s0;s<s0+n;s++)
+	{
+		double c = coef[s];
+		const double *sv = model->SV + (size_t)s * stride;
+		for(int j=0;j<model->dim;j++)
+			w[j] += c * sv[j];
+	}
+}
+
+svm_linear_model *svm_compile_linear(const svm_dense_model *model, size_t max_bytes) {
+	if(model->param.kernel_type != LINEAR)
+		return NULL;
+	if(max_bytes == 0)
+		max_bytes = SVM_LINEAR_MAX_BYTES;
+	svm_linear_model *lin = Malloc(svm_linear_model,1);
+	if(lin == NULL)
+		return NULL;
+	int nr_class = model->nr_class;
+	int l = model->l;
+	double dim = model->dim;
+	lin->model = model;
+	lin->w = NULL;
+	// A multiply and an add for every coefficient of every SV in a decision
+	if(one_decision(model))
+	{
+		lin->nr_pairs = 1;
+		lin->sv_flops = 2*l*dim + 2.0*l;
+	}
+	else
+	{
+		lin->nr_pairs = nr_class*(nr_class-1)/2;
+		lin->sv_flops = 2*l*dim + 2.0*(nr_class-1)*l;
+	}
+	lin->pair_flops = 2*lin->nr_pairs*dim;
+	lin->pair_bytes = (double)lin->nr_pairs * model->stride * sizeof(double);
+	if(lin->pair_flops >= lin->sv_flops || lin->pair_bytes > max_bytes)
+		return lin;
+
+	void *p;
+	if(posix_memalign(&p, SVM_DENSE_ALIGN, (size_t)lin->pair_bytes) != 0)
+		return lin;
+	lin->w = (double *)p;
+	memset(lin->w, 0, (size_t)lin->pair_bytes);
+	if(one_decision(model))
+	{
+		add_svs(model, model->sv_coef, 0, l, lin->w);
+		return lin;
+	}
+
+	int *start = Malloc(int,nr_class);
+	class_starts(model->nSV, nr_class, start);
+	int k=0;
+	for(int i=0;i<nr_class;i++)
+		for(int j=i+1;j<nr_class;j++)
+		{
+			double *w = lin->w + (size_t)k * model->stride;
+			add_svs(model, model->sv_coef + (size_t)(j-1)*l, start[i], model->nSV[i], w);
+			add_svs(model, model->sv_coef + (size_t)i*l, start[j], model->nSV[j], w);
+			k++;
+		}
+	free(start);
+	return lin;
+}
+
+void svm_free_linear_model(svm_linear_model *lin) {
+	if(lin == NULL)
+		return;
+	free(lin->w);
+	free(lin);
+}
+
+double svm_predict_linear(const svm_linear_model *lin, const double *x, svm_predict_context *ctx) {
+	const svm_dense_model *model = lin->model;
+	if(lin->w == NULL)
+		return svm_predict_dense_ctx(model, x, ctx);
+	int stride = model->stride;
+	if(one_decision(model))
+	{
+		double sum = svm_dense_dot(x, lin->w, stride) - model->rho[0];
+		ctx->dec_values[0] = sum;
+		if(model->param.svm_type == ONE_CLASS)
+			return (sum>0)?1:-1;
+		else
+			return sum;
+	}
+
+	int i;
+	int nr_class = model->nr_class;
+	int *vote = ctx->vote;
+	for(i=0;i<nr_class;i++)
+		vote[i] = 0;
+	int p=0;
+	for(i=0;i<nr_class;i++)
+		for(int j=i+1;j<nr_class;j++)
+		{
+			double sum = svm_dense_dot(x, lin->w + (size_t)p * stride, stride) - model->rho[p];
+			ctx->dec_values[p] = sum;
+			if(sum > 0)
+				++vote[i];
+			else
+				++vote[j];
+			p++;
+		}
+	ctx->pairs_evaluated += p;
+
+	return model->label[vote_winner(vote, nr_class)];
+}
@@ -0,0 +1,225 @@
+#include "svm.h"
+#include "svm_vote.h"
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define Malloc(type,n) (type *)malloc((n)*sizeof(type))
+
+// Kernel values per task when they are split across the pool
+#define SVM_POOL_SV_CHUNK 1024
+
+// Persistent workers. svm_pool_run hands them a job of numbered tasks and
+// works on it too; the tasks are taken from a shared counter, so uneven tasks
+// balance themselves. One job runs at a time.
+struct svm_pool {
+	std::vector<std::thread> workers;
+	std::mutex lock;
+	std::condition_variable wake;	// A job was posted or the pool is stopping
+	std::condition_variable idle;	// Every worker finished the job
+	unsigned long generation;	// Jobs posted so far
+	bool stopping;
+	void (*fn)(void *, int);
+	void *arg;
+	int tasks;
+	std::atomic<int> next;		// Next task to take
+	size_t finished;		// Workers done with the current job
+};
+
+static void pool_work(svm_pool *pool) {
+	for(int t = pool->next.fetch_add(1); t < pool->tasks; t = pool->next.fetch_add(1))
+		pool->fn(pool->arg, t);
+}
+
+static void pool_worker(svm_pool *pool) {
+	unsigned long seen = 0;
+	std::unique_lock<std::mutex> guard(pool->lock);
+	for(;;)
+	{
+		pool->wake.wait(guard, [&]() { return pool->stopping || pool->generation != seen; });
+		if(pool->stopping)
+			return;
+		seen = pool->generation;
+		guard.unlock();
+		pool_work(pool);
+		guard.lock();
+		if(++pool->finished == pool->workers.size())
+			pool->idle.notify_one();
+	}
+}
+
+svm_pool *svm_pool_create(int threads) {
+	if(threads <= 0)
+		threads = std::thread::hardware_concurrency();
+	if(threads <= 0)
+		threads = 1;
+	svm_pool *pool = new svm_pool();
+	pool->generation = 0;
+	pool->stopping = false;
+	pool->tasks = 0;
+	pool->next.store(0);
+	pool->finished = 0;
+	// The calling thread is the last worker
+	for(int i=1;i<threads;i++)
+		pool->workers.push_back(std::thread(pool_worker, pool));
+	return pool;
+}
+
+void svm_pool_destroy(svm_pool *pool) {
+	if(pool == NULL)
+		return;
+	{
+		std::lock_guard<std::mutex> guard(pool->lock);
+		pool->stopping = true;
+	}
+	pool->wake.notify_all();
+	for(size_t i=0;i<pool->workers.size();i++)
+		pool->workers[i].join();
+	delete pool;
+}
+
+int svm_pool_size(const svm_pool *pool) {
+	return pool->workers.size() + 1;
+}
+
+void svm_pool_run(svm_pool *pool, void (*fn)(void *, int), void *arg, int tasks) {
+	{
+		std::lock_guard<std::mutex> guard(pool->lock);
+		pool->fn = fn;
+		pool->arg = arg;
+		pool->tasks = tasks;
+		pool->next.store(0);
+		pool->finished = 0;
+		pool->generation++;
+	}
+	pool->wake.notify_all();
+	pool_work(pool);
+	std::unique_lock<std::mutex> guard(pool->lock);
+	pool->idle.wait(guard, [&]() { return pool->finished == pool->workers.size(); });
+}
+
+struct parallel_predict {
+	const svm_dense_model *model;
+	const double *x;
+	double *kvalue;
+	const int *start;
+	int nr_tasks;
+	int nr_pairs;
+	int *votes;			// nr_class votes per task
+};
+
+static void kernel_task(void *arg, int t) {
+	parallel_predict *job = (parallel_predict *)arg;
+	const svm_dense_model *model = job->model;
+	int s0 = t * SVM_POOL_SV_CHUNK;
+	int s1 = s0 + SVM_POOL_SV_CHUNK < model->l ? s0 + SVM_POOL_SV_CHUNK : model->l;
+	for(int s=s0;s<s1;s++)
+		job->kvalue[s] = svm_dense_k_function(job->x,model->SV+(size_t)s*model->stride,model->stride,&model->param);
+}
+
+// Votes of the class pairs in one contiguous range of pair numbers
+static void vote_task(void *arg, int t) {
+	parallel_predict *job = (parallel_predict *)arg;
+	const svm_dense_model *model = job->model;
+	int nr_class = model->nr_class;
+	int *vote = job->votes + (size_t)t * nr_class;
+	memset(vote, 0, nr_class*sizeof(int));
+	int p0 = (int)((long long)job->nr_pairs * t / job->nr_tasks);
+	int p1 = (int)((long long)job->nr_pairs * (t+1) / job->nr_tasks);
+	// Find the pair numbered p0, pairs of class i come before those of i+1
+	int i = 0, p = 0;
+	while(p + nr_class-1-i <= p0)
+	{
+		p += nr_class-1-i;
+		i++;
+	}
+	int j = i+1 + (p0-p);
+	for(p=p0;p<p1;p++)
+	{
+		if(pair_decision(model, job->kvalue, job->start, i, j, p) > 0)
+			++vote[i];
+		else
+			++vote[j];
+		if(++j == nr_class)
+		{
+			i++;
+			j = i+1;
+		}
+	}
+}
+
+double svm_predict_dense_parallel(const svm_dense_model *model, const double *x, svm_pool *pool) {
+	int i;
+	int l = model->l;
+	int nr_class = model->nr_class;
+	parallel_predict job;
+	job.model = model;
+	job.x = x;
+	job.kvalue = Malloc(double,l);
+	svm_pool_run(pool, kernel_task, &job, (l + SVM_POOL_SV_CHUNK-1) / SVM_POOL_SV_CHUNK);
+
+	if(one_decision(model))
+	{
+		double sum = 0;
+		for(i=0;i<l;i++)
+			sum += model->sv_coef[i] * job.kvalue[i];
+		sum -= model->rho[0];
+		free(job.kvalue);
+		if(model->param.svm_type == ONE_CLASS)
+			return (sum>0)?1:-1;
+		else
+			return sum;
+	}
+
+	int *start = Malloc(int,nr_class);
+	class_starts(model->nSV, nr_class, start);
+	job.start = start;
+	job.nr_pairs = nr_class*(nr_class-1)/2;
+	job.nr_tasks = svm_pool_size(pool);
+	if(job.nr_tasks > job.nr_pairs)
+		job.nr_tasks = job.nr_pairs > 0 ? job.nr_pairs : 1;
+	job.votes = Malloc(int,(size_t)job.nr_tasks * nr_class);
+	if(job.nr_pairs > 0)
+		svm_pool_run(pool, vote_task, &job, job.nr_tasks);
+	else
+		memset(job.votes, 0, nr_class*sizeof(int));
+
+	// Sum the votes of the tasks into the first one
+	for(int t=1;t<job.nr_tasks;t++)
+		for(i=0;i<nr_class;i++)
+			job.votes[i] += job.votes[(size_t)t*nr_class+i];
+	int vote_max_idx = vote_winner(job.votes, nr_class);
+
+	free(job.votes);
+	free(start);
+	free(job.kvalue);
+	return model->label[vote_max_idx];
+}
+
+struct parallel_batch {
+	const svm_dense_model *model;
+	const double *inputs;
+	int n;
+	double *out;
+};
+
+static void batch_task(void *arg, int t) {
+	parallel_batch *job = (parallel_batch *)arg;
+	int r0 = t * SVM_BATCH_ROWS;
+	int rows = job->n-r0 < SVM_BATCH_ROWS ? job->n-r0 : SVM_BATCH_ROWS;
+	svm_predict_batch(job->model, job->inputs + (size_t)r0 * job->model->stride, rows, job->out + r0);
+}
+
+void svm_predict_batch_parallel(const svm_dense_model *model, const double *inputs, int n, double *out,
+				svm_pool *pool) {
+	parallel_batch job;
+	job.model = model;
+	job.inputs = inputs;
+	job.n = n;
+	job.out = out;
+	svm_pool_run(pool, batch_task, &job, (n + SVM_BATCH_ROWS-1) / SVM_BATCH_ROWS);
+}
@@ -0,0 +1,223 @@
+#include "svm.h"
+#include <string.h>
+#include <immintrin.h>
+
+// Dense dot products and squared distances, one version per instruction set.
+// Each is compiled for its own target, so the file builds with the default
+// flags and only runs what the CPU supports. Every version accepts any n and
+// unaligned vectors; svm_dense_model rows are aligned and padded anyway.
+
+static double dot_scalar(const double *x, const double *y, int n) {
+	double sum = 0;
+	for(int i=0;i<n;i++)
+		sum += x[i] * y[i];
+	return sum;
+}
+
+static double dist2_scalar(const double *x, const double *y, int n) {
+	double sum = 0;
+	for(int i=0;i<n;i++)
+	{
+		double d = x[i] - y[i];
+		sum += d*d;
+	}
+	return sum;
+}
+
+__attribute__((target("sse2")))
+static double dot_sse2(const double *x, const double *y, int n) {
+	__m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+	int i = 0;
+	for(;i+4<=n;i+=4)
+	{
+		s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(x+i), _mm_loadu_pd(y+i)));
+		s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(x+i+2), _mm_loadu_pd(y+i+2)));
+	}
+	double r[2];
+	_mm_storeu_pd(r, _mm_add_pd(s0, s1));
+	double sum = r[0] + r[1];
+	for(;i<n;i++)
+		sum += x[i] * y[i];
+	return sum;
+}
+
+__attribute__((target("sse2")))
+static double dist2_sse2(const double *x, const double *y, int n) {
+	__m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+	int i = 0;
+	for(;i+4<=n;i+=4)
+	{
+		__m128d d0 = _mm_sub_pd(_mm_loadu_pd(x+i), _mm_loadu_pd(y+i));
+		__m128d d1 = _mm_sub_pd(_mm_loadu_pd(x+i+2), _mm_loadu_pd(y+i+2));
+		s0 = _mm_add_pd(s0, _mm_mul_pd(d0, d0));
+		s1 = _mm_add_pd(s1, _mm_mul_pd(d1, d1));
+	}
+	double r[2];
+	_mm_storeu_pd(r, _mm_add_pd(s0, s1));
+	double sum = r[0] + r[1];
+	for(;i<n;i++)
+	{
+		double d = x[i] - y[i];
+		sum += d*d;
+	}
+	return sum;
+}
+
+__attribute__((target("avx2,fma")))
+static double hsum_avx2(__m256d s) {
+	__m128d h = _mm_add_pd(_mm256_castpd256_pd128(s), _mm256_extractf128_pd(s, 1));
+	return _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+}
+
+__attribute__((target("avx2,fma")))
+static double dot_avx2(const double *x, const double *y, int n) {
+	__m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+	int i = 0;
+	for(;i+8<=n;i+=8)
+	{
+		s0 = _mm256_fmadd_pd(_mm256_loadu_pd(x+i), _mm256_loadu_pd(y+i), s0);
+		s1 = _mm256_fmadd_pd(_mm256_loadu_pd(x+i+4), _mm256_loadu_pd(y+i+4), s1);
+	}
+	double sum = hsum_avx2(_mm256_add_pd(s0, s1));
+	for(;i<n;i++)
+		sum += x[i] * y[i];
+	return sum;
+}
+
+__attribute__((target("avx2,fma")))
+static double dist2_avx2(const double *x, const double *y, int n) {
+	__m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+	int i = 0;
+	for(;i+8<=n;i+=8)
+	{
+		__m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(x+i), _mm256_loadu_pd(y+i));
+		__m256d d1 = _mm256_sub_pd(_mm256_loadu_pd(x+i+4), _mm256_loadu_pd(y+i+4));
+		s0 = _mm256_fmadd_pd(d0, d0, s0);
+		s1 = _mm256_fmadd_pd(d1, d1, s1);
+	}
+	double sum = hsum_avx2(_mm256_add_pd(s0, s1));
+	for(;i<n;i++)
+	{
+		double d = x[i] - y[i];
+		sum += d*d;
+	}
+	return sum;
+}
+
+// _mm512_reduce_add_pd trips -Wuninitialized in some versions of GCC
+__attribute__((target("avx512f")))
+static double hsum_avx512(__m512d s) {
+	double r[8];
+	_mm512_storeu_pd(r, s);
+	return ((r[0] + r[4]) + (r[1] + r[5])) + ((r[2] + r[6]) + (r[3] + r[7]));
+}
+
+__attribute__((target("avx512f")))
+static double dot_avx512(const double *x, const double *y, int n) {
+	__m512d s0 = _mm512_setzero_pd(), s1 = _mm512_setzero_pd();
+	int i = 0;
+	for(;i+16<=n;i+=16)
+	{
+		s0 = _mm512_fmadd_pd(_mm512_loadu_pd(x+i), _mm512_loadu_pd(y+i), s0);
+		s1 = _mm512_fmadd_pd(_mm512_loadu_pd(x+i+8), _mm512_loadu_pd(y+i+8), s1);
+	}
+	if(i+8<=n)
+	{
+		s0 = _mm512_fmadd_pd(_mm512_loadu_pd(x+i), _mm512_loadu_pd(y+i), s0);
+		i += 8;
+	}
+	double sum = hsum_avx512(_mm512_add_pd(s0, s1));
+	for(;i<n;i++)
+		sum += x[i] * y[i];
+	return sum;
+}
+
+__attribute__((target("avx512f")))
+static double dist2_avx512(const double *x, const double *y, int n) {
+	__m512d s0 = _mm512_setzero_pd(), s1 = _mm512_setzero_pd();
+	int i = 0;
+	for(;i+16<=n;i+=16)
+	{
+		__m512d d0 = _mm512_sub_pd(_mm512_loadu_pd(x+i), _mm512_loadu_pd(y+i));
+		__m512d d1 = _mm512_sub_pd(_mm512_loadu_pd(x+i+8), _mm512_loadu_pd(y+i+8));
+		s0 = _mm512_fmadd_pd(d0, d0, s0);
+		s1 = _mm512_fmadd_pd(d1, d1, s1);
+	}
+	if(i+8<=n)
+	{
+		__m512d d0 = _mm512_sub_pd(_mm512_loadu_pd(x+i), _mm512_loadu_pd(y+i));
+		s0 = _mm512_fmadd_pd(d0, d0, s0);
+		i += 8;
+	}
+	double sum = hsum_avx512(_mm512_add_pd(s0, s1));
+	for(;i<n;i++)
+	{
+		double d = x[i] - y[i];
+		sum += d*d;
+	}
+	return sum;
+}
+
+typedef double (*dense_fn)(const double *, const double *, int);
+
+static const char *simd_names[SVM_SIMD_COUNT] = { "scalar", "sse2", "avx2", "avx512" };
+static const dense_fn dot_fns[SVM_SIMD_COUNT] = { dot_scalar, dot_sse2, dot_avx2, dot_avx512 };
+static const dense_fn dist2_fns[SVM_SIMD_COUNT] = { dist2_scalar, dist2_sse2, dist2_avx2, dist2_avx512 };
+
+int svm_simd_supported(int level) {
+	// Needed when this runs before the constructors of libgcc
+	__builtin_cpu_init();
+	switch(level)
+	{
+		case SVM_SIMD_SCALAR:
+			return 1;
+		case SVM_SIMD_SSE2:
+			return __builtin_cpu_supports("sse2");
+		case SVM_SIMD_AVX2:
+			return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+		case SVM_SIMD_AVX512:
+			return __builtin_cpu_supports("avx512f");
+		default:
+			return 0;
+	}
+}
+
+int svm_simd_best() {
+	int level = SVM_SIMD_COUNT-1;
+	while(!svm_simd_supported(level))
+		level--;
+	return level;
+}
+
+const char *svm_simd_name(int level) {
+	return level >= 0 && level < SVM_SIMD_COUNT ? simd_names[level] : "unknown";
+}
+
+int svm_simd_find(const char *name) {
+	for(int i=0;i<SVM_SIMD_COUNT;i++)
+		if(strcmp(name, simd_names[i]) == 0)
+			return i;
+	return -1;
+}
+
+// Picked once when the program starts
+static int simd_level = svm_simd_best();
+
+int svm_simd_select(int level) {
+	if(level < 0 || level >= SVM_SIMD_COUNT || !svm_simd_supported(level))
+		return 0;
+	simd_level = level;
+	return 1;
+}
+
+int svm_simd_level() {
+	return simd_level;
+}
+
+double svm_dense_dot(const double *x, const double *y, int n) {
+	return dot_fns[simd_level](x, y, n);
+}
+
+double svm_dense_dist2(const double *x, const double *y, int n) {
+	return dist2_fns[simd_level](x, y, n);
+}
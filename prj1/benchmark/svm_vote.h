@@ -0,0 +1,165 @@
+#ifndef _SVM_VOTE_H_
+#define _SVM_VOTE_H_
+
+#include "svm.h"
+
+// The one-against-one vote shared by the sparse, dense, parallel and linear
+// predict paths. They differ only in how a row of coefficients is laid out,
+// which coef_row hides, so the helpers below take either kind of model.
+
+static inline const double *coef_row(const svm_model *model, int r) {
+	return model->sv_coef[r];
+}
+
+static inline const double *coef_row(const svm_dense_model *model, int r) {
+	return model->sv_coef + (size_t)r * model->l;
+}
+
+// ONE_CLASS and regression models have a single decision and no vote
+template <class Model>
+static inline bool one_decision(const Model *model) {
+	return model->param.svm_type == ONE_CLASS ||
+	       model->param.svm_type == EPSILON_SVR ||
+	       model->param.svm_type == NU_SVR;
+}
+
+// First SV of each class
+static inline void class_starts(const int *nSV, int nr_class, int *start) {
+	start[0] = 0;
+	for(int i=1;i<nr_class;i++)
+		start[i] = start[i-1]+nSV[i-1];
+}
+
+// Decision value of the class pair i < j, numbered p
+template <class Model>
+static inline double pair_decision(const Model *model, const double *kvalue, const int *start,
+				   int i, int j, int p) {
+	double sum = 0;
+	int si = start[i];
+	int sj = start[j];
+	int ci = model->nSV[i];
+	int cj = model->nSV[j];
+
+	int k;
+	const double *coef1 = coef_row(model, j-1);
+	const double *coef2 = coef_row(model, i);
+	for(k=0;k<ci;k++)
+		sum += coef1[si+k] * kvalue[si+k];
+	for(k=0;k<cj;k++)
+		sum += coef2[sj+k] * kvalue[sj+k];
+	return sum - model->rho[p];
+}
+
+// Most votes, lowest index on a tie
+static inline int vote_winner(const int *vote, int nr_class) {
+	int vote_max_idx = 0;
+	for(int i=1;i<nr_class;i++)
+		if(vote[i] > vote[vote_max_idx])
+			vote_max_idx = i;
+	return vote_max_idx;
+}
+
+// Pairs class c has left once the pairs up to (i, j) are decided, in the
+// order of the vote: every pair of class i before those of class i+1
+static inline int pairs_left(int nr_class, int i, int j, int c) {
+	if(c < i)
+		return 0;
+	if(c == i)
+		return nr_class-1-j;
+	return nr_class-1-i-(c <= j ? 1 : 0);
+}
+
+// Whether class c still wins over lead if it wins all of its pairs left
+static inline bool can_overtake(const int *vote, int nr_class, int i, int j, int c, int lead) {
+	int most = vote[c] + pairs_left(nr_class, i, j, c);
+	return most > vote[lead] || (most == vote[lead] && c < lead);
+}
+
+// Whether the pairs after (i, j) can no longer change lead, the winner so
+// far, even if it loses all of its own. Classes before i have no pairs left
+// and cannot beat lead. *rival is a class that could last time (-1 at
+// first); it is tried before the others, and is usually still in the way.
+static inline bool vote_decided(const int *vote, int nr_class, int i, int j, int lead, int *rival) {
+	// Every class after i other than lead has at least nr_class-2-i left
+	if(vote[lead] < nr_class-2-i)
+		return false;
+	if(*rival >= 0 && *rival != lead && can_overtake(vote, nr_class, i, j, *rival, lead))
+		return false;
+	for(int c=i;c<nr_class;c++)
+		if(c != lead && can_overtake(vote, nr_class, i, j, c, lead))
+		{
+			*rival = c;
+			return false;
+		}
+	return true;
+}
+
+// Label of a classification model from the kernel values of one input
+// against every SV. start and vote are workspace of nr_class entries, with
+// start already holding the first SV of each class. Decision values are
+// stored in dec_values if not NULL. The pairs are visited as vote_mode says
+// (see svm_predict_context), and the number decided and skipped are added to
+// evaluated and skipped if not NULL.
+template <class Model>
+static double vote_pairs(const Model *model, const double *kvalue, const int *start, int *vote,
+			 double *dec_values, int vote_mode, unsigned long *evaluated, unsigned long *skipped) {
+	int nr_class = model->nr_class;
+	int nr_pairs = nr_class*(nr_class-1)/2;
+	int decided = 0;
+	int winner;
+	if(vote_mode == SVM_VOTE_DAG)
+	{
+		// The loser of each pair leaves the list of candidates
+		int first = 0, last = nr_class-1;
+		while(first < last)
+		{
+			int p = first*(2*nr_class-first-1)/2 + last-first-1;
+			double sum = pair_decision(model, kvalue, start, first, last, p);
+			if(dec_values)
+				dec_values[p] = sum;
+			if(sum > 0)
+				last--;
+			else
+				first++;
+			decided++;
+		}
+		winner = first;
+	}
+	else
+	{
+		for(int i=0;i<nr_class;i++)
+			vote[i] = 0;
+
+		// lead is the winner so far, kept as the votes come in
+		int p=0, lead=0, rival=-1;
+		bool done = false;
+		for(int i=0;i<nr_class && !done;i++)
+			for(int j=i+1;j<nr_class;j++)
+			{
+				double sum = pair_decision(model, kvalue, start, i, j, p);
+				if(dec_values)
+					dec_values[p] = sum;
+
+				int won = sum > 0 ? i : j;
+				++vote[won];
+				if(vote[won] > vote[lead] || (vote[won] == vote[lead] && won < lead))
+					lead = won;
+				p++;
+				if(vote_mode == SVM_VOTE_EARLY_EXIT && p < nr_pairs &&
+				   vote_decided(vote, nr_class, i, j, lead, &rival))
+				{
+					done = true;
+					break;
+				}
+			}
+		decided = p;
+		winner = lead;
+	}
+	if(evaluated)
+		*evaluated += decided;
+	if(skipped)
+		*skipped += nr_pairs - decided;
+	return model->label[winner];
+}
+
+#endif
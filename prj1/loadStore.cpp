@@ -11,9 +11,18 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <stdlib.h>
 #include <string>
+#include <vector>
 #include "pin.H"
+#include "sim/mdsim.h"
+#include "sim/trace.h"
+#include "sim/sample.h"
+#include "sim/interval.h"
+#include "sim/topk.h"
+#include "sim/checkpoint.h"
+#include "sim/live.h"
 using std::cerr;
 using std::cout;
 using std::ofstream;
@@ -23,444 +32,407 @@ using std::string;
 using std::endl;
 
 static UINT64 STORE_RESOLVE_CYCLES = 30;
-static UINT64 IBQ_SIZE = 64;
-static UINT64 MDPT_SIZE = 128;
-static UINT64 MDST_SIZE = 128;
-
-ofstream OutFile;
-// The running count of instructions is kept here
-// make it static to help the compiler optimize docount
-static UINT64 cycles = 0;
+
 static UINT64 input = 0;
-static UINT64 ld_ins_count = 0;
-static UINT64 st_ins_count = 0;
-static UINT64 predictions = 0;
-static UINT64 mispredictions = 0;
-static UINT64 speculations = 0;
-static UINT64 mis_speculations = 0;
-static UINT64 false_deps = 0;
-static UINT64 ldst_buffer_time = 0;
-
-static UINT64 uncommitted_stores = 0;   // Keeps track of the number of uncommitted stores in IBQ
-
-struct IBQ_entry {
-    ADDRINT addr;
-    bool st;
-    bool ld;
-    bool speculative;
-    bool committed;
-    ADDRINT ea;
-};
 
-static IBQ_entry* IBQ = 0;
-static UINT64 IBQ_tail = 0;
-static UINT64 IBQ_count = 0;
-
-struct MDPT_entry {
-    bool valid;     // Valid flag
-    UINT64 ldpc;    // Load PC
-    UINT64 stpc;    // Store PC
-    UINT64 dist;    // Dependency distance
-    UINT64 pred;    // 2-bit up/down predictor
-    UINT64 last_access;     // Tracks last access cycle for LRU replacement strategy
+// The dependence prediction model lives in sim/mdsim.cpp so it can also be
+// driven from a recorded trace by sim/replay. Every simulator configuration
+// sees the same instruction stream and writes its own output file.
+static std::vector<MDSimConfig> Configs;
+static std::vector<ofstream*> OutFiles;
+static MDSampleConfig SampleConfig;
+
+// Optional checkpoints: one to restore at thread start, and one written at
+// -ckpt_at instructions of each thread or in Fini
+static MDCheckpoint RestoreCheckpoint;
+static BOOL Restoring = false;
+static MDCheckpoint OutCheckpoint;
+static PIN_LOCK CheckpointLock;
+
+// A pending checkpoint of one simulator, see MDSampler::markAt
+struct CheckpointMark {
+    THREADID tid;
+    UINT32 sim;
+    MDSampler* sampler;
+    MDSim* s;
 };
-static MDPT_entry* MDPT = 0;
-
-struct MDST_entry {
-    bool valid;     // Valid flag
-    UINT64 ldpc;    // Load PC
-    UINT64 stpc;    // Store PC
-    UINT64 ldid;    // Load ID
-    UINT64 stid;    // Store ID
-    UINT64 fe;      // Full/Empty flag
+
+// Records buffered per thread before they are passed to the simulators
+#define BUFFER_RECORDS 4096
+
+// Simulator state of one guest thread: one simulator per configuration, each
+// driven through a sampler (which passes all instructions through when
+// sampling is off). Threads never share a context, so the analysis routines
+// need no lock.
+struct ThreadContext {
+    THREADID tid;
+    std::vector<MDSim*> sims;
+    std::vector<MDSampler*> samplers;
+    std::vector<MDPairProfile*> profiles;   // Empty unless -topk is given
+    std::vector<CheckpointMark> marks;
+    // Instructions executed but not simulated yet
+    std::vector<MDSimRecord> buf;
+    size_t count;
+    UINT64 pending;     // Non-memory instructions after the last record
 };
-static MDST_entry* MDST = 0;
-
-VOID Init() {
-    // Initialize IBQ
-    cout << "Initializing IBQ" << endl;
-    IBQ = (IBQ_entry*) malloc(sizeof(IBQ_entry) * IBQ_SIZE);
-    cout << "IBQ Pointer: " << IBQ << endl;
-    // Initialize MDPT
-    MDPT = (MDPT_entry*) malloc(sizeof(MDPT_entry) * MDPT_SIZE);
-    for(UINT64 i = 0; i < MDPT_SIZE; i++) {
-        MDPT_entry mdpt;
-        mdpt.valid = false;
-        MDPT[i] = mdpt;
-    }
-    // Initialize MDST
-    MDST = (MDST_entry*) malloc(sizeof(MDST_entry) * MDST_SIZE);
-    for(UINT64 i = 0; i < MDST_SIZE; i++) {
-        MDST_entry mdst;
-        mdst.valid = false;
-        MDST[i] = mdst;
+static TLS_KEY ContextKey;
+// Every context created, merged in Fini. Only touched when a thread starts.
+static std::vector<ThreadContext*> Contexts;
+static PIN_LOCK ContextLock;
+
+// Optional interval statistics, drained by an internal tool thread
+static ofstream IntervalFile;
+static MDIntervalWriter* Intervals = 0;
+static PIN_THREAD_UID IntervalThreadUid;
+static volatile BOOL IntervalsDone = false;
+
+// Optional recording of the simulated instruction stream
+static TraceWriter* Trace = 0;
+static PIN_LOCK TraceLock;
+
+// Live statistics, see sim/live.h
+static MDLiveStats* Live = 0;
+
+KNOB<string> KnobTraceFile(KNOB_MODE_WRITEONCE, "pintool",
+    "trace", "", "record the instruction stream for sim/replay to this file");
+KNOB<UINT64> KnobMDPTSize(KNOB_MODE_WRITEONCE, "pintool",
+    "mdpt_size", "0", "number of MDPT entries (0 to match the IBQ size)");
+KNOB<UINT64> KnobMDPTWays(KNOB_MODE_WRITEONCE, "pintool",
+    "mdpt_ways", "4", "MDPT associativity (0 for fully associative)");
+KNOB<string> KnobSim(KNOB_MODE_APPEND, "pintool",
+    "sim", "", "add a simulator configuration, e.g. w=20,mdpt=256,o=loadStore_20.out "
+    "(keys: w, ibq, mdpt, ways, mdst, thr, pred, o). Without it input.txt gives the window");
+KNOB<UINT64> KnobSkip(KNOB_MODE_WRITEONCE, "pintool",
+    "skip", "0", "sampling: instructions to skip before the first detailed interval");
+KNOB<UINT64> KnobDetail(KNOB_MODE_WRITEONCE, "pintool",
+    "detail", "0", "sampling: instructions per detailed interval (0 simulates everything)");
+KNOB<UINT64> KnobFfwd(KNOB_MODE_WRITEONCE, "pintool",
+    "ffwd", "0", "sampling: instructions per fast-forward interval");
+KNOB<BOOL> KnobFfwdWarm(KNOB_MODE_WRITEONCE, "pintool",
+    "ffwd_warm", "1", "sampling: train the MDPT while fast-forwarding");
+KNOB<UINT64> KnobInterval(KNOB_MODE_WRITEONCE, "pintool",
+    "interval", "0", "write the counters of every simulator every this many instructions");
+KNOB<string> KnobIntervalFile(KNOB_MODE_WRITEONCE, "pintool",
+    "interval_o", "loadStore.intervals.csv", "interval output, JSON lines if it ends in .json or .jsonl");
+KNOB<UINT64> KnobIntervalRing(KNOB_MODE_WRITEONCE, "pintool",
+    "interval_ring", "4096", "interval snapshots buffered per thread and simulator");
+KNOB<UINT64> KnobTopK(KNOB_MODE_WRITEONCE, "pintool",
+    "topk", "0", "also report the load/store pairs with the most mis-speculations and false dependencies");
+KNOB<string> KnobCkptIn(KNOB_MODE_WRITEONCE, "pintool",
+    "ckpt_in", "", "resume from this checkpoint: restore the simulators and skip what they already ran");
+KNOB<string> KnobCkptWarm(KNOB_MODE_WRITEONCE, "pintool",
+    "ckpt_warm", "", "warm start from this checkpoint: restore the predictor tables only");
+KNOB<string> KnobCkptOut(KNOB_MODE_WRITEONCE, "pintool",
+    "ckpt_out", "", "write a checkpoint of the simulators to this file");
+KNOB<UINT64> KnobCkptAt(KNOB_MODE_WRITEONCE, "pintool",
+    "ckpt_at", "0", "checkpoint after this many instructions of each thread (0 for the end of the run)");
+KNOB<string> KnobLive(KNOB_MODE_WRITEONCE, "pintool",
+    "live", "", "publish the counters of every simulator to this file while running, e.g. /dev/shm/loadStore.live");
+KNOB<string> KnobOutputFile(KNOB_MODE_WRITEONCE, "pintool",
+    "o", "loadStore.out", "specify output file name");
+
+// Adds a simulator configuration and opens its output file
+static BOOL AddSim(const MDSimConfig& cfg, const string& out_name) {
+    ofstream* out = new ofstream(out_name.c_str());
+    if (!out->is_open()) {
+        cerr << "Cannot open output file " << out_name << endl;
+        delete out;
+        return false;
     }
+    cout << "STORE_RESOLVE_CYCLES = " << cfg.store_resolve_cycles << endl << "IBQ_SIZE = " << cfg.ibq_size << endl;
+    Configs.push_back(cfg);
+    OutFiles.push_back(out);
+    return true;
+}
+
+BOOL Init() {
     // Load Store Window from file
     ifstream input;
     input.open("input.txt");
     input >> STORE_RESOLVE_CYCLES;
-    // Calculate IBQ/MDPT/MDST size
-    // integer log2(n)s
-    int base = 0;
-    UINT64 calc = STORE_RESOLVE_CYCLES;
-    while (calc > 0) {
-        base++;
-        calc = calc>>1;
+    // IBQ/MDPT/MDST sizes are derived from the window
+    MDSimConfig cfg = mdsim_default_config(STORE_RESOLVE_CYCLES);
+    if (KnobMDPTSize.Value() != 0)
+        cfg.mdpt_size = KnobMDPTSize.Value();
+    cfg.mdpt_ways = KnobMDPTWays.Value();
+    SampleConfig.skip = KnobSkip.Value();
+    SampleConfig.detail = KnobDetail.Value();
+    SampleConfig.ffwd = KnobFfwd.Value();
+    SampleConfig.warm = KnobFfwdWarm.Value();
+    string restore = !KnobCkptIn.Value().empty() ? KnobCkptIn.Value() : KnobCkptWarm.Value();
+    if (!restore.empty()) {
+        if (!RestoreCheckpoint.read(restore)) {
+            cerr << "Cannot read checkpoint " << restore << endl;
+            return false;
+        }
+        Restoring = true;
+    }
+    if (KnobSim.NumberOfValues() == 0)
+        return AddSim(cfg, KnobOutputFile.Value());
+    // One simulator per -sim configuration, all fed from this run
+    for (UINT32 i = 0; i < KnobSim.NumberOfValues(); i++) {
+        MDSimConfig sim_cfg = cfg;
+        std::ostringstream out_name;
+        out_name << KnobOutputFile.Value() << "." << i;
+        string name = out_name.str();
+        if (!mdsim_parse_config(KnobSim.Value(i), sim_cfg, &name)) {
+            cerr << "Bad -sim configuration: " << KnobSim.Value(i) << endl;
+            return false;
+        }
+        if (!AddSim(sim_cfg, name))
+            return false;
     }
-    base++;
-    IBQ_SIZE = 1<<base;
-    MDPT_SIZE = IBQ_SIZE;
-    MDST_SIZE = IBQ_SIZE;
-    cout << "STORE_RESOLVE_CYCLES = " << STORE_RESOLVE_CYCLES << endl << "IBQ_SIZE = " << IBQ_SIZE << endl;
+    return true;
 }
 
 VOID Release() {
-    free(MDST);
-    free(MDPT);
-    free(IBQ);
-}
-
-// Allocates the next available MDPT entry
-UINT64 allocateNewMDPTEntry() {
-    // Search for the first invalid entry, or the lease recently used entry
-    UINT64 lru = 0;
-    UINT64 lru_last_access = MDPT[0].last_access;
-    for (UINT64 i = 0; i < MDPT_SIZE; i++) {
-        // Invalid entry found. Return its index
-        if (!MDPT[i].valid)
-            return(i);
-        if (MDPT[i].last_access < lru_last_access) {
-            lru_last_access = MDPT[i].last_access;
-            lru = i;
+    for (size_t c = 0; c < Contexts.size(); c++) {
+        for (size_t i = 0; i < Contexts[c]->sims.size(); i++) {
+            delete Contexts[c]->samplers[i];
+            delete Contexts[c]->sims[i];
         }
+        for (size_t i = 0; i < Contexts[c]->profiles.size(); i++)
+            delete Contexts[c]->profiles[i];
+        delete Contexts[c];
     }
-    // No invalid entries found. Return the least recently used entry
-    return (lru);
+    for (size_t i = 0; i < OutFiles.size(); i++)
+        delete OutFiles[i];
+    Contexts.clear();
+    Configs.clear();
+    OutFiles.clear();
 }
 
-// This function is called before every instruction is executed
-VOID docount(ADDRINT ins_addr, bool ins_st, bool ins_ld, ADDRINT ea) {
-    cycles++;
-
-    // Check to see if previous stores have been resolved
-    // We're starting from the top of the IBQ rather than the bottom
-    // so we can chain resolve instructions (ie. if a store resolves,
-    // and a junior load was waiting, we can resolve both in one loop)
-    // cout << "Cycle: " << cycles << endl;
-
-    // We only check if its been STORE_RESOLVE_CYCLES since a store has entered IBQ
-    if (IBQ_count >= STORE_RESOLVE_CYCLES) {
-        int index = IBQ_tail - STORE_RESOLVE_CYCLES;
-        if (index < 0) {
-            index = index + IBQ_SIZE;
-        }
-        // Look for uncommitted store
-        if (IBQ[index].st && !IBQ[index].committed) {
-            // Should be committed
-            IBQ[index].committed = true;
-            uncommitted_stores--;
-            // Update the MDST as well
-            for (UINT64 j = 0; j < MDST_SIZE; j++) {
-                if (MDST[j].valid && MDST[j].stpc == IBQ[index].addr && MDST[j].stid == (UINT64) index) {
-                    // Mark the entry as complete
-                    MDST[j].fe = true;
-                    
-                    // cout << "Res MDST: " << j << ": L" << MDST[j].ldpc << " S" << MDST[j].stpc << " DL" << MDST[j].ldid << " DS" << MDST[j].stid << " FE" << MDST[j].fe << endl;
-                    // Commit the corresponding Load (if it exists)
-                    UINT64 ldid = MDST[j].ldid;
-                    // Make sure the entry was actually used
-                    if (ldid < IBQ_SIZE && IBQ[ldid].ld && IBQ[ldid].addr == MDST[j].ldpc) {
-                        // Find the corresponding MDPT table entry for updating
-                        UINT64 k = 0;
-                        for (; k < MDPT_SIZE; k++)
-                            if (MDPT[k].valid && MDPT[k].ldpc == IBQ[ldid].addr && MDPT[k].stpc == IBQ[index].addr)
-                                break;
-                        MDPT[k].last_access = cycles;
-                        // Check whether it was a true dependency, and whether the prediction was correct
-                        if (IBQ[ldid].ea == IBQ[index].ea) {
-                            // True dependecy found. Update MDPT and Check for misprediction
-                            // cout << "True Dep" << endl;
-                            if (MDPT[k].pred < 3) {
-                                MDPT[k].pred++;
-                            }
-                            // cout << "Prd MDPT: " << k << ": L" << MDPT[k].ldpc << " S" << MDPT[k].stpc << " D" << MDPT[k].dist << " P" << MDPT[k].pred << endl;
-                            if (IBQ[ldid].speculative) {
-                                // MDPT Misprediction and Mis-speculation
-                                mispredictions++;
-                                mis_speculations++;
-                                // Put the Load back through the LSQ (1 cycle penalty)
-                                ldst_buffer_time++;
-                                IBQ[ldid].speculative = false;
-                                IBQ[ldid].committed = true;
-                            }
-                            else {
-                                // Commit the Load
-                                IBQ[ldid].committed = true;
-                                // Add the Load's waiting time in the LSQ
-                                int time = IBQ_tail - ldid;
-                                if (time < 0) {
-                                    time += IBQ_SIZE;
-                                }
-                                ldst_buffer_time += time;
-                            }
-                        }
-                        else {
-                            // False dependency found. Update MDPT and check for misprediction
-                            if (MDPT[k].pred > 0) {
-                                MDPT[k].pred--;
-                            }
-                            // cout << "Prd MDPT: " << k << ": L" << MDPT[k].ldpc << " S" << MDPT[k].stpc << " D" << MDPT[k].dist << " P" << MDPT[k].pred << endl;
-                            if (!IBQ[ldid].speculative) {
-                                // cout << "False Dep" << endl;
-                                mispredictions++;
-                                false_deps++;
-                                // Commit the Load
-                                IBQ[ldid].committed = true;
-                                // Add the Load's waiting time in the LSQ
-                                int time = IBQ_tail - ldid;
-                                if (time < 0) {
-                                    time += IBQ_SIZE;
-                                }
-                                ldst_buffer_time += time;
-                            }
-                            else {
-                                // If it was speculative, just mark it as committed
-                                IBQ[ldid].speculative = false;
-                                IBQ[ldid].committed = true;
-                            }
-                        }
-                    }
-                }
-            }
-            // Now we need to walk through the last STORE_RESOLVE_CYCLES IBQ entries to find uncaught Load conflicts
-            // NOTE: We are doing this step by walking the IBQ because we don't have a CDB in this simulation
-            for (UINT64 j = 1; j <= STORE_RESOLVE_CYCLES; j++) {
-                int jindex = IBQ_tail - j;
-                if (jindex < 0) {
-                    jindex = jindex + IBQ_SIZE;
-                }
-                if (IBQ[jindex].speculative && IBQ[jindex].ea == IBQ[index].ea) {
-                    // Found a Load conflict without an MDPT entry
-                    // Mis-speculation
-                    mis_speculations++;
-                    // Commit the Load
-                    IBQ[jindex].committed = true;
-                    IBQ[jindex].speculative = false;
-                    ldst_buffer_time++;
-                    // Make a new MDPT entry
-                    int diff = jindex - index;
-                    if (diff < 0)
-                        diff = diff + IBQ_SIZE;
-                    MDPT_entry mdpt;
-                    mdpt.valid = true;
-                    mdpt.ldpc = IBQ[jindex].addr;
-                    mdpt.stpc = IBQ[index].addr;
-                    mdpt.dist = diff;
-                    mdpt.pred = 1;
-                    mdpt.last_access = cycles;
-                    UINT64 mdpt_index = allocateNewMDPTEntry();
-                    MDPT[mdpt_index] = mdpt;
-
-                    // cout << "New MDPT: " << mdpt_index << ": L" << MDPT[mdpt_index].ldpc << " S" << MDPT[mdpt_index].stpc << " D" << MDPT[mdpt_index].dist << " P" << MDPT[mdpt_index].pred << endl;
-                }
+// Adds one simulator to the output checkpoint and rewrites it. Called by the
+// thread that owns the simulator, between two of its instructions.
+static VOID CheckpointSim(VOID* arg)
+{
+    CheckpointMark* m = static_cast<CheckpointMark*>(arg);
+    PIN_GetLock(&CheckpointLock, m->tid + 1);
+    OutCheckpoint.put(m->tid, m->sim, m->sampler->instructions(), *m->s);
+    if (!OutCheckpoint.write(KnobCkptOut.Value()))
+        cerr << "Cannot write checkpoint " << KnobCkptOut.Value() << endl;
+    PIN_ReleaseLock(&CheckpointLock);
+}
+
+// Creates the simulators of a new guest thread
+VOID ThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v)
+{
+    ThreadContext* ctx = new ThreadContext();
+    ctx->tid = tid;
+    // The marks must not move once the samplers point at them
+    ctx->marks.resize(Configs.size());
+    for (size_t i = 0; i < Configs.size(); i++) {
+        MDSim* sim = mdsim_create(Configs[i]);
+        UINT64 done = 0;
+        if (Restoring) {
+            PIN_GetLock(&CheckpointLock, tid + 1);
+            if (!RestoreCheckpoint.get(tid, i, *sim, &done))
+                cerr << "No matching checkpoint for thread " << tid << " simulator " << i << endl;
+            PIN_ReleaseLock(&CheckpointLock);
+            if (KnobCkptIn.Value().empty()) {
+                // Warm start
+                sim->flush();
+                sim->resetStats();
+                done = 0;
             }
         }
-    }
-    // Done with committing stores
-
-    // Create a new IBQ entry
-    IBQ_entry ibq;
-    ibq.addr = ins_addr;
-    ibq.st = ins_st;
-    ibq.ld = ins_ld;
-    ibq.ea = ea;
-    
-    // If the instruction was a load, we have to search for potential store dependencies in MDPT
-    if (ins_ld) {
-        ld_ins_count++;
-        // Walk throught the MDPT, looking for historic store conflicts
-        UINT64 i = 0;
-        for (; i < MDPT_SIZE; i++)
-            if (MDPT[i].valid && MDPT[i].ldpc == ins_addr)
-                break;
-        if (i < MDPT_SIZE) {
-            // Find the corresponding MDST entry
-            int st_index = IBQ_tail - MDPT[i].dist;
-            if (st_index < 0)
-                st_index = st_index + IBQ_SIZE;
-            UINT64 j = 0;
-            for (; j < MDST_SIZE; j++)
-                if (MDST[j].valid && MDST[j].ldpc == MDPT[i].ldpc && MDST[j].stpc == MDPT[i].stpc && MDST[j].ldid == IBQ_SIZE)
-                    break;
-            if (j == MDST_SIZE) {
-                // The store never made it to the pipeline
-                // No need to speculate
-                ibq.speculative = false;
-                ibq.committed = true;
-                ldst_buffer_time++;
-                //Something bad happened. Print some info
-                // cout << "ADDR.ID.EA.LD.ST.SPEC.COMMIT" << endl;
-                // printf("Load: %lx.%d.%lx.%d.%d.%d.%d\n", ibq.addr, (int) IBQ_tail, ibq.ea, ibq.ld, ibq.st, ibq.speculative, ibq.committed);
-                // cout << "Expected Store at ID " << st_index << endl;
-                // printf("Stor: %lx.%d.%lx.%d.%d.%d.%d\n", IBQ[st_index].addr, st_index, IBQ[st_index].ea, IBQ[st_index].ld, IBQ[st_index].st, IBQ[st_index].speculative, IBQ[st_index].committed);
-                // // Now see if store actually exists
-                // for (UINT64 ii = 0; ii < IBQ_SIZE; ii++) {
-                //     if (IBQ[ii].st && IBQ[ii].addr == MDPT[i].stpc) {
-                //         cout << "Found potential real match at " << ii << endl;
-                //         printf("Stor: %lx.%d.%lx.%d.%d.%d.%d\n", IBQ[ii].addr, (int) ii, IBQ[ii].ea, IBQ[ii].ld, IBQ[ii].st, IBQ[ii].speculative, IBQ[ii].committed);
-                //     }
-                // }
-            }
-            // If the store has already committed, then no need to predict
-            else if (MDST[j].fe) {
-                // Found the entry. Add the load ID
-                MDST[j].ldid = IBQ_tail;
-                // cout << "Udt MDST: " << j << ": L" << MDST[j].ldpc << " S" << MDST[j].stpc << " DL" << MDST[j].ldid << " DS" << MDST[j].stid << " FE" << MDST[j].fe << endl;
-                ibq.speculative = false;
-                ibq.committed = true;
-                ldst_buffer_time++;
-            }
-            // Predict whether there is a dependency
-            else {
-                // Found the entry. Add the load ID
-                MDST[j].ldid = IBQ_tail;
-                // cout << "Udt MDST: " << j << ": L" << MDST[j].ldpc << " S" << MDST[j].stpc << " DL" << MDST[j].ldid << " DS" << MDST[j].stid << " FE" << MDST[j].fe << endl;
-                predictions++;
-                if (MDPT[i].pred < 2) {
-                    // Predict no dependency (speculate)
-                    speculations++;
-                    ibq.speculative = true;
-                    ibq.committed = false;
-                    ldst_buffer_time++;
-                }
-                else {
-                    // Predict dependency
-                    ibq.speculative = false;
-                    ibq.committed = false;
-                }
-            }
+        if (Live)
+            sim->setLive(Live->addSlot(tid, i, Configs[i]));
+        ctx->sims.push_back(sim);
+        ctx->samplers.push_back(new MDSampler(sim, SampleConfig));
+        ctx->samplers.back()->resume(done);
+        if (Intervals)
+            ctx->samplers.back()->logIntervals(Intervals->addRing(tid, i, KnobIntervalRing.Value()),
+                                               KnobInterval.Value());
+        if (KnobTopK.Value() > 0) {
+            ctx->profiles.push_back(new MDPairProfile(mdpair_capacity(KnobTopK.Value())));
+            ctx->sims.back()->setProfile(ctx->profiles.back());
         }
-        else {
-            // No MDPT entry found. We always predict no dependency here
-            // If there are uncommitted stores in the IBQ, then we speculate
-            if (uncommitted_stores > 0) {
-                speculations++;
-                ibq.speculative = true;
-                ibq.committed = false;
-                ldst_buffer_time++;
-            }
-            else {
-                // No uncommitted stores, so this load is fully committed (no speculation)
-                ibq.speculative = false;
-                ibq.committed = true;
-                ldst_buffer_time++;
-            }
+        if (!KnobCkptOut.Value().empty() && KnobCkptAt.Value() > 0) {
+            CheckpointMark& m = ctx->marks[i];
+            m.tid = tid;
+            m.sim = i;
+            m.sampler = ctx->samplers.back();
+            m.s = sim;
+            m.sampler->markAt(KnobCkptAt.Value(), CheckpointSim, &m);
         }
     }
+    ctx->buf.resize(BUFFER_RECORDS);
+    ctx->count = 0;
+    ctx->pending = 0;
+    PIN_SetThreadData(ContextKey, ctx, tid);
+    PIN_GetLock(&ContextLock, tid + 1);
+    Contexts.push_back(ctx);
+    PIN_ReleaseLock(&ContextLock);
+}
 
-    // If the instruction is a store, we have to search for potential load dependencies in MDPT
-    if (ins_st) {
-        st_ins_count++;
-        uncommitted_stores++;
-        ibq.committed = false;
-        ibq.speculative = false;
-        // Walk through the MDPT, looking for previous load conflicts
-        for (UINT64 i = 0; i < MDPT_SIZE; i++) {
-            if (MDPT[i].valid && MDPT[i].stpc == ins_addr) {
-                // Found a previous conflict. Make a new MDST entry
-                MDST_entry mdst;
-                mdst.valid = true;
-                mdst.ldpc = MDPT[i].ldpc;
-                mdst.stpc = MDPT[i].stpc;
-                mdst.ldid = IBQ_SIZE;
-                mdst.stid = IBQ_tail;
-                mdst.fe = false;
-
-                // Insert into the MDST wherever there's an invalid entry
-                for (UINT64 j = 0; j < MDST_SIZE; j++) {
-                    if (!MDST[j].valid) {
-                        MDST[j] = mdst;
-                        // cout << "New MDST: " << j << ": L" << MDST[j].ldpc << " S" << MDST[j].stpc << " DL" << MDST[j].ldid << " DS" << MDST[j].stid << " FE" << MDST[j].fe << endl;
-                        break;
-                    }
-                }
-            }
+// Passes a thread's buffered records to its simulators and the trace
+static VOID FlushThread(ThreadContext* ctx)
+{
+    if (Trace) {
+        PIN_GetLock(&TraceLock, ctx->tid + 1);
+        for (size_t r = 0; r < ctx->count; r++) {
+            const MDSimRecord& rec = ctx->buf[r];
+            Trace->writeNonMem(ctx->tid, rec.nonmem);
+            if (rec.ld || rec.st)
+                Trace->write(ctx->tid, rec.pc, rec.st, rec.ld, rec.ea);
         }
+        PIN_ReleaseLock(&TraceLock);
+    }
+    for (size_t i = 0; i < ctx->samplers.size(); i++)
+        ctx->samplers[i]->stepBatch(&ctx->buf[0], ctx->count);
+    ctx->count = 0;
+}
+
+// Flushes everything a thread has executed, including its trailing
+// non-memory instructions
+static VOID FinishThread(ThreadContext* ctx)
+{
+    if (ctx->pending > 0) {
+        MDSimRecord& rec = ctx->buf[ctx->count++];
+        rec.nonmem = ctx->pending;
+        rec.pc = 0;
+        rec.ea = 0;
+        rec.ld = false;
+        rec.st = false;
+        ctx->pending = 0;
     }
+    FlushThread(ctx);
+}
 
-    // Retire the top most instruction in the IBQ (if the IBQ is full)
-    if (IBQ_count >= IBQ_SIZE) {
-        // If its a store, then we need to remove its MDST entries
-        if (IBQ[IBQ_tail].st) {
-            // Walk through MDST to invalidate all this Store's entries
-            UINT64 j = 0;
-            for (; j < MDST_SIZE; j++) {
-                if (MDST[j].valid && MDST[j].stpc == IBQ[IBQ_tail].addr && MDST[j].stid == IBQ_tail) {
-                    MDST[j].valid = false;
-                }
+VOID ThreadFini(THREADID tid, const CONTEXT *ctxt, INT32 code, VOID *v)
+{
+    FinishThread(static_cast<ThreadContext*>(PIN_GetThreadData(ContextKey, tid)));
+}
+
+// Called before every memory instruction, with the number of non-memory
+// instructions in its basic block since the previous memory instruction
+VOID RecordMem(THREADID tid, ADDRINT ins_addr, bool ins_st, bool ins_ld, ADDRINT ea, UINT32 nonmem) {
+    ThreadContext* ctx = static_cast<ThreadContext*>(PIN_GetThreadData(ContextKey, tid));
+    MDSimRecord& rec = ctx->buf[ctx->count++];
+    rec.nonmem = ctx->pending + nonmem;
+    rec.pc = ins_addr;
+    rec.ea = ea;
+    rec.ld = ins_ld;
+    rec.st = ins_st;
+    ctx->pending = 0;
+    if (ctx->count == BUFFER_RECORDS)
+        FlushThread(ctx);
+}
+
+// Called before the last instruction of a basic block, with the number of
+// non-memory instructions after its last memory instruction
+VOID RecordNonMem(THREADID tid, UINT32 nonmem) {
+    ThreadContext* ctx = static_cast<ThreadContext*>(PIN_GetThreadData(ContextKey, tid));
+    ctx->pending += nonmem;
+}
+
+// Pin calls this function every time a new trace is encountered
+VOID InstrumentTrace(TRACE trace, VOID *v)
+{
+    // Only memory instructions get an analysis call. The non-memory
+    // instructions between them are counted here and passed along.
+    for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl)) {
+        UINT32 nonmem = 0;
+        for (INS ins = BBL_InsHead(bbl); INS_Valid(ins); ins = INS_Next(ins)) {
+            // If the instruction is a load or store, send the Effective Address as well
+            if (INS_IsMemoryRead(ins)) {
+                INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)RecordMem,
+                IARG_THREAD_ID,
+                IARG_INST_PTR,          // Instruction Address
+                IARG_BOOL, true,        // Is a store?
+                IARG_BOOL, false,       // Is a load?
+                IARG_MEMORYREAD_EA,     // Memory Effective Address
+                IARG_UINT32, nonmem,    // Non-memory instructions before it
+                IARG_END);
+                nonmem = 0;
+            }
+            else if (INS_IsMemoryWrite(ins)) {
+                INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)RecordMem,
+                IARG_THREAD_ID,
+                IARG_INST_PTR,          // Instruction Address
+                IARG_BOOL, false,       // Is a store?
+                IARG_BOOL, true,        // Is a load?
+                IARG_MEMORYWRITE_EA,    // Memory Effective Address
+                IARG_UINT32, nonmem,    // Non-memory instructions before it
+                IARG_END);
+                nonmem = 0;
+            }
+            else {
+                nonmem++;
             }
         }
+        if (nonmem > 0)
+            INS_InsertCall(BBL_InsTail(bbl), IPOINT_BEFORE, (AFUNPTR)RecordNonMem,
+            IARG_THREAD_ID,
+            IARG_UINT32, nonmem,
+            IARG_END);
     }
-
-    // Add the new instruction to the IBQ
-    IBQ[IBQ_tail] = ibq;
-    IBQ_tail++;
-    if (IBQ_tail >= IBQ_SIZE)
-        IBQ_tail = 0;
-    if (IBQ_count < IBQ_SIZE)
-        IBQ_count++;
 }
-    
-// Pin calls this function every time a new instruction is encountered
-VOID Instruction(INS ins, VOID *v)
+
+// Writes out interval snapshots while the application runs
+VOID IntervalThread(VOID *v)
 {
-    // Insert a call to docount before every instruction
-    // If the instruction is a load or store, send the Effective Address as well
-    if (INS_IsMemoryRead(ins))
-        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)docount,
-        IARG_INST_PTR,          // Instruction Address
-        IARG_BOOL, true,        // Is a store?
-        IARG_BOOL, false,       // Is a load?
-        IARG_MEMORYREAD_EA,     // Memory Effective Address
-        IARG_END);
-    else if (INS_IsMemoryWrite(ins))
-        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)docount,
-        IARG_INST_PTR,          // Instruction Address
-        IARG_BOOL, false,       // Is a store?
-        IARG_BOOL, true,        // Is a load?
-        IARG_MEMORYWRITE_EA,    // Memory Effective Address
-        IARG_END);
-    else
-        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)docount,
-        IARG_INST_PTR,          // Instruction Address
-        IARG_BOOL, false,       // Is a store?
-        IARG_BOOL, false,       // Is a load?
-        IARG_ADDRINT, 0,        // Memory Effective Address
-        IARG_END);
+    while (!IntervalsDone && !PIN_IsProcessExiting()) {
+        if (Intervals->drain() == 0)
+            PIN_Sleep(1);
+    }
 }
 
-KNOB<string> KnobOutputFile(KNOB_MODE_WRITEONCE, "pintool",
-    "o", "loadStore.out", "specify output file name");
+// Internal threads have to exit before Fini
+VOID PrepareForFini(VOID *v)
+{
+    IntervalsDone = true;
+    PIN_WaitForThreadTermination(IntervalThreadUid, PIN_INFINITE_TIMEOUT, NULL);
+}
 
 // This function is called when the application exits
 VOID Fini(INT32 code, VOID *v)
 {
+    // Flush any thread that did not get a ThreadFini, then merge the threads
+    // into the first context. The other threads have stopped by now, so no
+    // lock is needed.
+    for (size_t c = 0; c < Contexts.size(); c++)
+        FinishThread(Contexts[c]);
+    // Checkpoint before reporting, which ends the sampling intervals
+    if (!KnobCkptOut.Value().empty() && KnobCkptAt.Value() == 0) {
+        for (size_t c = 0; c < Contexts.size(); c++)
+            for (size_t i = 0; i < Configs.size(); i++)
+                OutCheckpoint.put(Contexts[c]->tid, i, Contexts[c]->samplers[i]->instructions(),
+                                  *Contexts[c]->sims[i]);
+        if (!OutCheckpoint.write(KnobCkptOut.Value()))
+            cerr << "Cannot write checkpoint " << KnobCkptOut.Value() << endl;
+    }
+    for (size_t c = 1; c < Contexts.size(); c++)
+        for (size_t i = 0; i < Configs.size(); i++)
+            Contexts[0]->samplers[i]->merge(*Contexts[c]->samplers[i]);
+    for (size_t c = 1; c < Contexts.size(); c++)
+        for (size_t i = 0; i < Contexts[0]->profiles.size(); i++)
+            Contexts[0]->profiles[i]->merge(*Contexts[c]->profiles[i]);
     // Write to a file since cout and cerr maybe closed by the application
-    OutFile.setf(ios::showbase);
-    OutFile << "Store Resolve Window: " << STORE_RESOLVE_CYCLES << endl;
-    OutFile << "Total Instructions: " << cycles << endl;
-    OutFile << "Total Loads: " << ld_ins_count << endl;
-    OutFile << "Total Stores: " << st_ins_count << endl;
-    OutFile << "Total MDPT Predictions: " << predictions << endl;
-    OutFile << "Total MDPT Mispredictions: " << mispredictions << endl;
-    OutFile << "Misprediction Rate: " << (double)mispredictions / (double)predictions << endl;
-    OutFile << "Total Load Speculations: " << speculations << endl;
-    OutFile << "Total Load Mis-speculations: " << mis_speculations << endl;
-    OutFile << "Mis-speculation Rate: " << (double)mis_speculations / (double)speculations << endl;
-    OutFile << "Total False Dependencies: "<< false_deps << endl;
-    OutFile << "Mis-speculations due to False Dependencies: " << (double)false_deps / (double)mis_speculations << endl;
-    OutFile << "Avg. Time in LD/ST Buffer (Loads): " << (double) ldst_buffer_time / (double) ld_ins_count << endl;
-    OutFile.close();
+    for (size_t i = 0; i < Configs.size() && !Contexts.empty(); i++) {
+        OutFiles[i]->setf(ios::showbase);
+        Contexts[0]->samplers[i]->report(*OutFiles[i]);
+        if (!Contexts[0]->profiles.empty())
+            mdpair_report(*OutFiles[i], *Contexts[0]->profiles[i], KnobTopK.Value());
+        OutFiles[i]->close();
+    }
+    if (Intervals) {
+        // Merging and reporting snapshotted the last intervals
+        Intervals->drain();
+        if (Intervals->dropped() > 0)
+            IntervalFile << "# " << Intervals->dropped() << " snapshots dropped" << endl;
+        delete Intervals;
+        IntervalFile.close();
+    }
+    if (Trace) {
+        Trace->close();
+        delete Trace;
+    }
+    if (Live) {
+        Live->finish();
+        delete Live;
+    }
 
     Release();
 }
@@ -484,22 +456,58 @@ INT32 Usage()
 
 int main(int argc, char * argv[])
 {
-    // Initialize data structures
-    Init();
     // Initialize pin
     if (PIN_Init(argc, argv)) return Usage();
-    OutFile.open(KnobOutputFile.Value().c_str());
+    // Initialize data structures (after PIN_Init so the knobs are parsed)
+    if (!Init()) return Usage();
+    if (!KnobTraceFile.Value().empty()) {
+        Trace = new TraceWriter();
+        if (!Trace->open(KnobTraceFile.Value().c_str())) {
+            cerr << "Cannot open trace file " << KnobTraceFile.Value() << endl;
+            delete Trace;
+            Trace = 0;
+        }
+    }
+    if (KnobInterval.Value() > 0) {
+        IntervalFile.open(KnobIntervalFile.Value().c_str());
+        if (IntervalFile.is_open())
+            Intervals = new MDIntervalWriter(IntervalFile, mdinterval_jsonl(KnobIntervalFile.Value()));
+        else
+            cerr << "Cannot open interval file " << KnobIntervalFile.Value() << endl;
+    }
+    if (!KnobLive.Value().empty()) {
+        Live = new MDLiveStats();
+        if (!Live->create(KnobLive.Value(), MDLIVE_SLOTS)) {
+            cerr << "Cannot create live statistics file " << KnobLive.Value() << endl;
+            delete Live;
+            Live = 0;
+        }
+    }
     ifstream InputFile("input.txt");
 
     InputFile >> input;
     
     //cout << "Here was the input file:" << endl << input << endl;
 
-    // Register Instruction to be called to instrument instructions
-    INS_AddInstrumentFunction(Instruction, 0);
+    ContextKey = PIN_CreateThreadDataKey(0);
+    PIN_InitLock(&ContextLock);
+    PIN_InitLock(&TraceLock);
+    PIN_InitLock(&CheckpointLock);
+    PIN_AddThreadStartFunction(ThreadStart, 0);
+    PIN_AddThreadFiniFunction(ThreadFini, 0);
+
+    // Register InstrumentTrace to be called to instrument instructions
+    TRACE_AddInstrumentFunction(InstrumentTrace, 0);
 
     // Register Fini to be called when the application exits
     PIN_AddFiniFunction(Fini, 0);
+    if (Intervals) {
+        PIN_AddPrepareForFiniFunction(PrepareForFini, 0);
+        if (PIN_SpawnInternalThread(IntervalThread, 0, 0, &IntervalThreadUid) == INVALID_THREADID) {
+            cerr << "Cannot start the interval writer thread" << endl;
+            return 1;
+        }
+    }
     
     // Start the program, never returns
     PIN_StartProgram();
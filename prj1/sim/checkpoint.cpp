@@ -0,0 +1,92 @@
+#include "checkpoint.h"
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <sstream>
+
+static const char CHECKPOINT_MAGIC[8] = { 'M', 'D', 'C', 'K', 'P', 'T', '0', '1' };
+
+const MDCheckpoint::Entry* MDCheckpoint::find(uint32_t tid, uint32_t sim) const {
+    for (size_t i = 0; i < entries.size(); i++)
+        if (entries[i].tid == tid && entries[i].sim == sim)
+            return &entries[i];
+    return NULL;
+}
+
+void MDCheckpoint::put(uint32_t tid, uint32_t sim, uint64_t instructions, const MDSim& s) {
+    std::ostringstream image;
+    s.save(image);
+    Entry* e = NULL;
+    for (size_t i = 0; i < entries.size() && e == NULL; i++)
+        if (entries[i].tid == tid && entries[i].sim == sim)
+            e = &entries[i];
+    if (e == NULL) {
+        entries.push_back(Entry());
+        e = &entries.back();
+        e->tid = tid;
+        e->sim = sim;
+    }
+    e->instructions = instructions;
+    e->state = image.str();
+}
+
+bool MDCheckpoint::get(uint32_t tid, uint32_t sim, MDSim& s, uint64_t* instructions) const {
+    const Entry* e = find(tid, sim);
+    if (e == NULL)
+        return false;
+    std::istringstream image(e->state);
+    if (!s.load(image))
+        return false;
+    if (instructions)
+        *instructions = e->instructions;
+    return true;
+}
+
+bool MDCheckpoint::write(const std::string& path) const {
+    std::string tmp = path + ".tmp";
+    std::ofstream out(tmp.c_str(), std::ios::binary);
+    if (!out.is_open())
+        return false;
+    uint64_t n = entries.size();
+    out.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    out.write((const char*) &n, sizeof(n));
+    for (size_t i = 0; i < entries.size(); i++) {
+        const Entry& e = entries[i];
+        uint64_t len = e.state.size();
+        out.write((const char*) &e.tid, sizeof(e.tid));
+        out.write((const char*) &e.sim, sizeof(e.sim));
+        out.write((const char*) &e.instructions, sizeof(e.instructions));
+        out.write((const char*) &len, sizeof(len));
+        out.write(e.state.data(), len);
+    }
+    out.close();
+    if (!out)
+        return false;
+    return rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+bool MDCheckpoint::read(const std::string& path) {
+    std::ifstream in(path.c_str(), std::ios::binary);
+    char magic[sizeof(CHECKPOINT_MAGIC)];
+    uint64_t n;
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0)
+        return false;
+    if (!in.read((char*) &n, sizeof(n)))
+        return false;
+    std::vector<Entry> read_entries;
+    for (uint64_t i = 0; i < n; i++) {
+        read_entries.push_back(Entry());
+        Entry& e = read_entries.back();
+        uint64_t len;
+        if (!in.read((char*) &e.tid, sizeof(e.tid)) ||
+            !in.read((char*) &e.sim, sizeof(e.sim)) ||
+            !in.read((char*) &e.instructions, sizeof(e.instructions)) ||
+            !in.read((char*) &len, sizeof(len)))
+            return false;
+        e.state.resize(len);
+        if (len > 0 && !in.read(&e.state[0], len))
+            return false;
+    }
+    entries.swap(read_entries);
+    return true;
+}
@@ -0,0 +1,47 @@
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "mdsim.h"
+
+// Checkpoints of the simulator state, so a run can start with trained tables
+// or resume where another one stopped. A file holds the state of any number
+// of simulators, each tagged with its guest thread, the index of its
+// configuration and the instructions that thread had run when it was saved.
+// The state is a raw image of the tables (see MDSim::save), so a checkpoint is
+// only read back by the same build with the same configurations.
+//
+// File layout: the magic "MDCKPT01", the number of entries, then per entry
+// the thread, configuration index, instruction count, image size and image.
+class MDCheckpoint {
+public:
+    // Saves the state of one simulator, replacing an older entry of it
+    void put(uint32_t tid, uint32_t sim, uint64_t instructions, const MDSim& s);
+    // Restores one simulator, and the instructions it had run. Returns false
+    // if there is no entry for it or the entry does not match its
+    // configuration.
+    bool get(uint32_t tid, uint32_t sim, MDSim& s, uint64_t* instructions) const;
+    size_t size() const { return entries.size(); }
+
+    // The file is replaced atomically, so an interrupted run leaves the
+    // previous checkpoint intact
+    bool write(const std::string& path) const;
+    bool read(const std::string& path);
+
+private:
+    struct Entry {
+        uint32_t tid;
+        uint32_t sim;
+        uint64_t instructions;
+        std::string state;
+    };
+
+    const Entry* find(uint32_t tid, uint32_t sim) const;
+
+    std::vector<Entry> entries;
+};
+
+#endif
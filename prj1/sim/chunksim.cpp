@@ -0,0 +1,187 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <unistd.h>
+
+#include "mdsim.h"
+#include "trace.h"
+#include "tracesim.h"
+
+using namespace std;
+
+// Simulates one configuration over a binary trace by splitting the trace into
+// chunks that are simulated in parallel. Each chunk starts with a warm-up
+// prefix taken from the end of the previous chunk: it trains the MDPT but its
+// counters are thrown away. The chunk counters are summed at the end.
+
+static void usage(const char* prog) {
+    cerr << "usage: " << prog << " [-s config] [-k chunks] [-u warmup] [-j threads] [-v] <binary trace>" << endl;
+    cerr << "  -s  simulator configuration, e.g. w=20,mdpt=256 (see mdsim_parse_config)" << endl;
+    cerr << "  -k  number of chunks (default: number of threads)" << endl;
+    cerr << "  -u  warm-up instructions before each chunk (default 1000000)" << endl;
+    cerr << "  -j  worker threads (default: number of cores)" << endl;
+    cerr << "  -v  also run the whole trace serially and report the error" << endl;
+}
+
+struct Chunk {
+    TracePos warm_pos;      // Position where the warm-up starts
+    uint64_t warm;          // Warm-up instructions
+    uint64_t len;           // Instructions counted in this chunk
+    MDSimStats stats;
+};
+
+static void worker(const TraceReader* reader, const MDSimConfig* cfg, vector<Chunk>* chunks,
+                   atomic<size_t>* next) {
+    for (;;) {
+        size_t i = next->fetch_add(1);
+        if (i >= chunks->size())
+            return;
+        Chunk& ch = (*chunks)[i];
+        TraceSims sims(*cfg);
+        TracePos pos = ch.warm_pos;
+        tracesim_run(*reader, pos, ch.warm, &sims);
+        sims.resetStats();
+        tracesim_run(*reader, pos, ch.len, &sims);
+        ch.stats = sims.stats();
+    }
+}
+
+static double rate(uint64_t a, uint64_t b) {
+    return (double) a / (double) b;
+}
+
+// Prints the relative error of one metric against the serial run
+static void error_line(const char* name, double approx, double exact) {
+    double err = exact != 0 ? fabs(approx - exact) / fabs(exact) : fabs(approx - exact);
+    cout << name << ": " << approx << " vs " << exact << " (" << err * 100 << "%)" << endl;
+}
+
+int main(int argc, char** argv) {
+    using namespace std::chrono;
+
+    MDSimConfig cfg = mdsim_default_config(30);
+    unsigned threads = thread::hardware_concurrency();
+    uint64_t k = 0;
+    uint64_t warmup = 1000000;
+    bool verify = false;
+    int c;
+    while ((c = getopt(argc, argv, "s:k:u:j:vh")) != -1) {
+        switch (c) {
+            case 's':
+                if (!mdsim_parse_config(optarg, cfg, NULL)) {
+                    cerr << "bad simulator configuration " << optarg << endl;
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'k':
+                k = strtoull(optarg, NULL, 0);
+                break;
+            case 'u':
+                warmup = strtoull(optarg, NULL, 0);
+                break;
+            case 'j':
+                threads = strtoul(optarg, NULL, 0);
+                break;
+            case 'v':
+                verify = true;
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (threads == 0)
+        threads = 1;
+    if (k == 0)
+        k = threads;
+    // Report the configuration as the simulators resolve it
+    MDSim* probe = mdsim_create(cfg);
+    cfg = probe->config();
+    delete probe;
+
+    TraceReader reader;
+    if (!reader.open(argv[optind])) {
+        cerr << argv[optind] << " is not a binary trace" << endl;
+        return EXIT_FAILURE;
+    }
+
+    high_resolution_clock::time_point t0 = high_resolution_clock::now();
+
+    // Skim the trace once to find where each warm-up starts
+    uint64_t total = reader.instructions();
+    if (total == 0) {
+        TracePos pos = tracesim_begin(reader);
+        total = tracesim_run(reader, pos, UINT64_MAX, NULL);
+    }
+    vector<Chunk> chunks(k);
+    TracePos pos = tracesim_begin(reader);
+    uint64_t at = 0;
+    for (uint64_t i = 0; i < k; i++) {
+        uint64_t start = total * i / k;
+        uint64_t end = total * (i + 1) / k;
+        uint64_t warm_start = start > warmup ? start - warmup : 0;
+        at += tracesim_run(reader, pos, warm_start - at, NULL);
+        chunks[i].warm_pos = pos;
+        chunks[i].warm = start - warm_start;
+        chunks[i].len = end - start;
+    }
+
+    atomic<size_t> next(0);
+    vector<thread> pool;
+    for (unsigned t = 0; t < threads && t < k; t++)
+        pool.push_back(thread(worker, &reader, &cfg, &chunks, &next));
+    for (size_t t = 0; t < pool.size(); t++)
+        pool[t].join();
+
+    MDSimStats merged;
+    memset(&merged, 0, sizeof(merged));
+    for (uint64_t i = 0; i < k; i++)
+        mdsim_stats_add(merged, chunks[i].stats);
+    double secs = duration_cast<duration<double>>(high_resolution_clock::now() - t0).count();
+
+    // The serial reference runs once the workers are done, so neither time
+    // is taken while the other competes for the cores
+    MDSimStats serial;
+    memset(&serial, 0, sizeof(serial));
+    double serial_secs = 0;
+    if (verify) {
+        high_resolution_clock::time_point s0 = high_resolution_clock::now();
+        TraceSims sims(cfg);
+        TracePos p = tracesim_begin(reader);
+        tracesim_run(reader, p, UINT64_MAX, &sims);
+        serial = sims.stats();
+        serial_secs = duration_cast<duration<double>>(high_resolution_clock::now() - s0).count();
+    }
+
+    cout.setf(ios::showbase);
+    mdsim_report(cout, cfg, merged);
+    cout << "Chunks: " << k << endl;
+    cout << "Warm-up Instructions per Chunk: " << warmup << endl;
+    cout << "Chunked Time (s): " << secs << endl;
+
+    if (verify) {
+        cout << "Serial Time (s): " << serial_secs << endl;
+        cout << "Relative Error vs Serial Run:" << endl;
+        error_line("  MDPT Predictions", merged.predictions, serial.predictions);
+        error_line("  Misprediction Rate", rate(merged.mispredictions, merged.predictions),
+            rate(serial.mispredictions, serial.predictions));
+        error_line("  Load Speculations", merged.speculations, serial.speculations);
+        error_line("  Mis-speculation Rate", rate(merged.mis_speculations, merged.speculations),
+            rate(serial.mis_speculations, serial.speculations));
+        error_line("  False Dependencies", merged.false_deps, serial.false_deps);
+        error_line("  Avg. Time in LD/ST Buffer", rate(merged.ldst_buffer_time, merged.ld_ins_count),
+            rate(serial.ldst_buffer_time, serial.ld_ins_count));
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,112 @@
+#include "interval.h"
+#include <stdlib.h>
+
+using std::endl;
+
+MDIntervalRing::MDIntervalRing(uint32_t t, uint32_t s, size_t capacity)
+    : tid(t), sim(s), next(NULL), head(0), tail(0), drops(0) {
+    uint64_t n = 1;
+    while (n < capacity)
+        n <<= 1;
+    mask = n - 1;
+    buf = (MDIntervalSnapshot*) malloc(sizeof(MDIntervalSnapshot) * n);
+}
+
+MDIntervalRing::~MDIntervalRing() {
+    free(buf);
+}
+
+void MDIntervalRing::push(uint64_t instructions, const MDSimStats& stats) {
+    uint64_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) > mask) {
+        drops.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    MDIntervalSnapshot& s = buf[h & mask];
+    s.tid = tid;
+    s.sim = sim;
+    s.instructions = instructions;
+    s.stats = stats;
+    head.store(h + 1, std::memory_order_release);
+}
+
+bool MDIntervalRing::pop(MDIntervalSnapshot& s) {
+    uint64_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire))
+        return false;
+    s = buf[t & mask];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+}
+
+MDIntervalWriter::MDIntervalWriter(std::ostream& o, bool j) : out(o), jsonl(j), rings(NULL) {
+    if (!jsonl)
+        out << "thread,sim,instructions,interval,loads,stores,predictions,mispredictions,"
+            << "speculations,mis_speculations,false_deps,ldst_buffer_time" << endl;
+}
+
+MDIntervalWriter::~MDIntervalWriter() {
+    MDIntervalRing* r = rings.load();
+    while (r) {
+        MDIntervalRing* next = r->next;
+        delete r;
+        r = next;
+    }
+}
+
+MDIntervalRing* MDIntervalWriter::addRing(uint32_t tid, uint32_t sim, size_t capacity) {
+    MDIntervalRing* r = new MDIntervalRing(tid, sim, capacity);
+    r->next = rings.load();
+    while (!rings.compare_exchange_weak(r->next, r))
+        ;
+    return r;
+}
+
+void MDIntervalWriter::write(const MDIntervalSnapshot& s) {
+    const MDSimStats& st = s.stats;
+    if (jsonl) {
+        out << "{\"thread\":" << s.tid << ",\"sim\":" << s.sim
+            << ",\"instructions\":" << s.instructions << ",\"interval\":" << st.cycles
+            << ",\"loads\":" << st.ld_ins_count << ",\"stores\":" << st.st_ins_count
+            << ",\"predictions\":" << st.predictions << ",\"mispredictions\":" << st.mispredictions
+            << ",\"speculations\":" << st.speculations << ",\"mis_speculations\":" << st.mis_speculations
+            << ",\"false_deps\":" << st.false_deps << ",\"ldst_buffer_time\":" << st.ldst_buffer_time
+            << "}\n";
+    }
+    else {
+        out << s.tid << "," << s.sim << "," << s.instructions << "," << st.cycles << ","
+            << st.ld_ins_count << "," << st.st_ins_count << ","
+            << st.predictions << "," << st.mispredictions << ","
+            << st.speculations << "," << st.mis_speculations << ","
+            << st.false_deps << "," << st.ldst_buffer_time << "\n";
+    }
+}
+
+size_t MDIntervalWriter::drain() {
+    size_t n = 0;
+    MDIntervalSnapshot s;
+    for (MDIntervalRing* r = rings.load(); r; r = r->next) {
+        while (r->pop(s)) {
+            write(s);
+            n++;
+        }
+    }
+    if (n > 0)
+        out.flush();
+    return n;
+}
+
+uint64_t MDIntervalWriter::dropped() const {
+    uint64_t n = 0;
+    for (MDIntervalRing* r = rings.load(); r; r = r->next)
+        n += r->dropped();
+    return n;
+}
+
+bool mdinterval_jsonl(const std::string& name) {
+    size_t dot = name.rfind('.');
+    if (dot == std::string::npos)
+        return false;
+    std::string ext = name.substr(dot);
+    return ext == ".json" || ext == ".jsonl";
+}
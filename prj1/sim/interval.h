@@ -0,0 +1,83 @@
+#ifndef _INTERVAL_H_
+#define _INTERVAL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <ostream>
+#include <string>
+#include "mdsim.h"
+
+// Interval statistics. A simulating thread snapshots the counters of one
+// simulator every N instructions (see MDSampler::logIntervals) into a
+// preallocated ring, and a writer drains all rings to a CSV or JSON lines
+// file from another thread. The simulating thread never blocks or allocates:
+// when a ring is full the snapshot is dropped and counted.
+
+struct MDIntervalSnapshot {
+    uint32_t tid;           // Guest thread
+    uint32_t sim;           // Simulator configuration
+    uint64_t instructions;  // Instructions of the thread at the end of the interval
+    MDSimStats stats;       // Counters of this interval only
+};
+
+// Single producer, single consumer ring of snapshots
+class MDIntervalRing {
+public:
+    MDIntervalRing(uint32_t tid, uint32_t sim, size_t capacity);
+    ~MDIntervalRing();
+
+    // Called by the simulating thread
+    void push(uint64_t instructions, const MDSimStats& stats);
+    // Called by the writer
+    bool pop(MDIntervalSnapshot& s);
+    uint64_t dropped() const { return drops.load(std::memory_order_relaxed); }
+
+private:
+    friend class MDIntervalWriter;
+    MDIntervalRing(const MDIntervalRing&);
+    MDIntervalRing& operator=(const MDIntervalRing&);
+
+    MDIntervalSnapshot* buf;
+    uint64_t mask;          // Capacity minus one, a power of two
+    uint32_t tid;
+    uint32_t sim;
+    MDIntervalRing* next;   // Writer's list, fixed once published
+    // Producer and consumer positions, kept on separate cache lines
+    std::atomic<uint64_t> head;
+    char pad[64];
+    std::atomic<uint64_t> tail;
+    std::atomic<uint64_t> drops;
+};
+
+class MDIntervalWriter {
+public:
+    // Snapshots are written to out, which is not owned. A CSV header is
+    // written right away.
+    MDIntervalWriter(std::ostream& out, bool jsonl);
+    ~MDIntervalWriter();
+
+    // Creates a ring for one simulator of one thread. Safe to call from any
+    // thread while another one drains.
+    MDIntervalRing* addRing(uint32_t tid, uint32_t sim, size_t capacity);
+    // Writes out the pending snapshots of every ring and returns how many
+    // there were. Only one thread may drain at a time.
+    size_t drain();
+    // Snapshots lost to full rings
+    uint64_t dropped() const;
+
+private:
+    MDIntervalWriter(const MDIntervalWriter&);
+    MDIntervalWriter& operator=(const MDIntervalWriter&);
+
+    void write(const MDIntervalSnapshot& s);
+
+    std::ostream& out;
+    bool jsonl;
+    std::atomic<MDIntervalRing*> rings;
+};
+
+// True if the file name asks for JSON lines (.json or .jsonl) rather than CSV
+bool mdinterval_jsonl(const std::string& name);
+
+#endif
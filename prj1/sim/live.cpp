@@ -0,0 +1,118 @@
+#include "live.h"
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char LIVE_MAGIC[8] = { 'M', 'D', 'L', 'I', 'V', 'E', '0', '1' };
+
+void MDLiveSlot::publish(const MDSimStats& stats) {
+    const uint64_t* v = reinterpret_cast<const uint64_t*>(&stats);
+    uint64_t s = seq.load(std::memory_order_relaxed);
+    seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < MDLIVE_COUNTERS; i++)
+        counters[i].store(v[i], std::memory_order_relaxed);
+    seq.store(s + 2, std::memory_order_release);
+}
+
+bool MDLiveSlot::read(MDSimStats& stats) const {
+    uint64_t* v = reinterpret_cast<uint64_t*>(&stats);
+    for (;;) {
+        uint64_t s = seq.load(std::memory_order_acquire);
+        if (s == 0)
+            return false;
+        if (s & 1)
+            continue;
+        for (size_t i = 0; i < MDLIVE_COUNTERS; i++)
+            v[i] = counters[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq.load(std::memory_order_relaxed) == s)
+            return true;
+    }
+}
+
+MDLiveStats::MDLiveStats() : hdr(NULL), slot_base(NULL), bytes(0) {
+}
+
+MDLiveStats::~MDLiveStats() {
+    unmap();
+}
+
+void MDLiveStats::unmap() {
+    if (hdr)
+        munmap(hdr, bytes);
+    hdr = NULL;
+    slot_base = NULL;
+    bytes = 0;
+}
+
+bool MDLiveStats::create(const std::string& path, size_t slots) {
+    unmap();
+    size_t size = sizeof(MDLiveHeader) + slots * sizeof(MDLiveSlot);
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+    // A new file reads as zeroes, which is every slot unclaimed
+    void* p = MAP_FAILED;
+    if (ftruncate(fd, size) == 0)
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return false;
+    hdr = static_cast<MDLiveHeader*>(p);
+    slot_base = reinterpret_cast<MDLiveSlot*>(hdr + 1);
+    bytes = size;
+    hdr->slots = slots;
+    hdr->pid = getpid();
+    // Readers check the magic last
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(hdr->magic, LIVE_MAGIC, sizeof(LIVE_MAGIC));
+    return true;
+}
+
+bool MDLiveStats::attach(const std::string& path) {
+    unmap();
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat sb;
+    void* p = MAP_FAILED;
+    if (fstat(fd, &sb) == 0 && (size_t) sb.st_size >= sizeof(MDLiveHeader))
+        p = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return false;
+    hdr = static_cast<MDLiveHeader*>(p);
+    slot_base = reinterpret_cast<MDLiveSlot*>(hdr + 1);
+    bytes = sb.st_size;
+    if (memcmp(hdr->magic, LIVE_MAGIC, sizeof(LIVE_MAGIC)) != 0 ||
+        sizeof(MDLiveHeader) + hdr->slots * sizeof(MDLiveSlot) > bytes) {
+        unmap();
+        return false;
+    }
+    return true;
+}
+
+MDLiveSlot* MDLiveStats::addSlot(uint32_t tid, uint32_t sim, const MDSimConfig& cfg) {
+    uint64_t i = hdr->used.fetch_add(1);
+    if (i >= hdr->slots)
+        return NULL;
+    MDLiveSlot* s = &slot_base[i];
+    s->tid = tid;
+    s->sim = sim;
+    s->cfg = cfg;
+    // An even, non-zero sequence number makes the slot visible
+    s->seq.store(2, std::memory_order_release);
+    return s;
+}
+
+void MDLiveStats::finish() {
+    hdr->done.store(1, std::memory_order_release);
+}
+
+size_t MDLiveStats::used() const {
+    uint64_t n = hdr->used.load(std::memory_order_acquire);
+    return n < hdr->slots ? n : hdr->slots;
+}
@@ -0,0 +1,77 @@
+#ifndef _LIVE_H_
+#define _LIVE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <string>
+#include "mdsim.h"
+
+// Live statistics. The counters of every simulator are published into a
+// shared file mapping (e.g. under /dev/shm) so another process can watch a
+// run while it goes, see the livestats tool. A simulator publishes once per
+// batch (see MDSim::setLive), never blocks and never does I/O. Each slot is
+// a seqlock with a single writer: readers retry while the sequence number
+// is odd or changed under them.
+
+#define MDLIVE_COUNTERS (sizeof(MDSimStats) / sizeof(uint64_t))
+
+// Slots in a segment unless told otherwise
+#define MDLIVE_SLOTS 1024
+
+struct MDLiveSlot {
+    std::atomic<uint64_t> seq;      // 0 until claimed, odd while updating
+    uint32_t tid;                   // Guest thread
+    uint32_t sim;                   // Simulator configuration
+    MDSimConfig cfg;
+    std::atomic<uint64_t> counters[MDLIVE_COUNTERS];
+    char pad[48];                   // Slots of different threads do not share a line
+
+    // Called by the simulating thread
+    void publish(const MDSimStats& stats);
+    // Returns false if the slot is unclaimed
+    bool read(MDSimStats& stats) const;
+};
+
+struct MDLiveHeader {
+    char magic[8];
+    uint64_t slots;
+    uint64_t pid;                   // Writing process
+    std::atomic<uint64_t> used;     // Slots claimed so far
+    std::atomic<uint64_t> done;     // Set when the writer finishes
+    char pad[24];                   // The slots start on a cache line
+};
+
+class MDLiveStats {
+public:
+    MDLiveStats();
+    ~MDLiveStats();
+
+    // Creates or truncates the segment, for the writing process
+    bool create(const std::string& path, size_t slots);
+    // Maps an existing segment read-only
+    bool attach(const std::string& path);
+
+    // Claims a slot for one simulator of one thread, or returns NULL if the
+    // segment is full. Safe to call from any thread.
+    MDLiveSlot* addSlot(uint32_t tid, uint32_t sim, const MDSimConfig& cfg);
+    // Marks the run as finished
+    void finish();
+
+    size_t used() const;
+    const MDLiveSlot& slot(size_t i) const { return slot_base[i]; }
+    bool done() const { return hdr->done.load(std::memory_order_acquire) != 0; }
+    uint64_t pid() const { return hdr->pid; }
+
+private:
+    MDLiveStats(const MDLiveStats&);
+    MDLiveStats& operator=(const MDLiveStats&);
+
+    void unmap();
+
+    MDLiveHeader* hdr;
+    MDLiveSlot* slot_base;
+    size_t bytes;
+};
+
+#endif
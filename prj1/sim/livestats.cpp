@@ -0,0 +1,118 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <signal.h>
+#include <unistd.h>
+
+#include "mdsim.h"
+#include "live.h"
+
+using namespace std;
+
+// Watches a run that publishes live statistics (-live for the pintool, -L for
+// replay and sweep). Prints the instructions, simulated MIPS and rates of
+// every simulator at a fixed period until the run finishes.
+
+static void usage(const char* prog) {
+    cerr << "usage: " << prog << " [-i seconds] [-n samples] [-x rate [-m instructions]] <live file>" << endl;
+    cerr << "  -i  seconds between samples (default 1)" << endl;
+    cerr << "  -n  stop after this many samples (default: when the run finishes)" << endl;
+    cerr << "  -x  stop the run with SIGTERM if a mis-speculation rate goes over this" << endl;
+    cerr << "  -m  instructions a simulator must have run before -x applies (default 10000000)" << endl;
+}
+
+static const char* predictor_name(uint64_t p) {
+    return p < mdsim_predictor_count() ? mdsim_predictor(p).name : "?";
+}
+
+static double rate(uint64_t a, uint64_t b) {
+    return b ? (double) a / (double) b : 0;
+}
+
+int main(int argc, char** argv) {
+    using namespace std::chrono;
+
+    double period = 1;
+    uint64_t samples = 0;
+    double abort_rate = 0;
+    uint64_t abort_min = 10000000;
+    int c;
+    while ((c = getopt(argc, argv, "i:n:x:m:h")) != -1) {
+        switch (c) {
+            case 'i':
+                period = strtod(optarg, NULL);
+                break;
+            case 'n':
+                samples = strtoull(optarg, NULL, 0);
+                break;
+            case 'x':
+                abort_rate = strtod(optarg, NULL);
+                break;
+            case 'm':
+                abort_min = strtoull(optarg, NULL, 0);
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    MDLiveStats live;
+    if (!live.attach(argv[optind])) {
+        cerr << argv[optind] << " is not a live statistics file" << endl;
+        return EXIT_FAILURE;
+    }
+
+    high_resolution_clock::time_point t0 = high_resolution_clock::now();
+    high_resolution_clock::time_point last = t0;
+    vector<uint64_t> prev;
+    cout << fixed;
+    for (uint64_t n = 1; ; n++) {
+        // Read the flag first so the last sample is complete
+        bool finished = live.done();
+        high_resolution_clock::time_point now = high_resolution_clock::now();
+        double dt = duration_cast<duration<double>>(now - last).count();
+        last = now;
+        size_t used = live.used();
+        prev.resize(used, UINT64_MAX);
+        cout << "[" << setprecision(1) << duration_cast<duration<double>>(now - t0).count() << "s] pid "
+             << live.pid() << ", " << used << " simulators" << (finished ? ", finished" : "") << endl;
+        cout << "   tid  sim    w pred       instructions      MIPS  mis-spec   mispred" << endl;
+        for (size_t i = 0; i < used; i++) {
+            const MDLiveSlot& s = live.slot(i);
+            MDSimStats st;
+            if (!s.read(st))
+                continue;
+            // Rates are 0 on the first sample of a simulator, or after a reset
+            double mips = 0;
+            if (prev[i] != UINT64_MAX && st.cycles >= prev[i] && dt > 0)
+                mips = (st.cycles - prev[i]) / dt / 1e6;
+            double misspec = rate(st.mis_speculations, st.speculations);
+            prev[i] = st.cycles;
+            cout << setw(6) << s.tid << setw(5) << s.sim << setw(5) << s.cfg.store_resolve_cycles << " "
+                 << left << setw(8) << predictor_name(s.cfg.predictor) << right
+                 << setw(16) << st.cycles << setw(10) << setprecision(2) << mips
+                 << setw(10) << setprecision(4) << misspec
+                 << setw(10) << rate(st.mispredictions, st.predictions) << endl;
+            if (abort_rate > 0 && !finished && st.cycles >= abort_min && misspec > abort_rate) {
+                cerr << "thread " << s.tid << " simulator " << s.sim << " mis-speculation rate " << misspec
+                     << " is over " << abort_rate << ", stopping pid " << live.pid() << endl;
+                kill(live.pid(), SIGTERM);
+                return 2;
+            }
+        }
+        if (finished || n == samples)
+            break;
+        this_thread::sleep_for(duration<double>(period));
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,733 @@
+#include "mdsim.h"
+#include "predictors.h"
+#include "topk.h"
+#include "live.h"
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+using std::endl;
+
+MDSimConfig mdsim_default_config(uint64_t store_resolve_cycles) {
+    // Calculate IBQ/MDPT/MDST size
+    // integer log2(n)s
+    int base = 0;
+    uint64_t calc = store_resolve_cycles;
+    while (calc > 0) {
+        base++;
+        calc = calc>>1;
+    }
+    base++;
+    MDSimConfig cfg;
+    cfg.store_resolve_cycles = store_resolve_cycles;
+    cfg.ibq_size = (uint64_t) 1<<base;
+    cfg.mdpt_size = cfg.ibq_size;
+    cfg.mdpt_ways = 4;
+    cfg.mdst_size = cfg.ibq_size;
+    cfg.pred_threshold = 2;
+    cfg.predictor = 0;
+    return cfg;
+}
+
+bool mdsim_parse_config(const std::string& spec, MDSimConfig& cfg, std::string* out_name) {
+    // Split into key=value pairs
+    std::vector<std::string> keys, values;
+    size_t pos = 0;
+    while (pos <= spec.size() && !spec.empty()) {
+        size_t comma = spec.find(',', pos);
+        if (comma == std::string::npos)
+            comma = spec.size();
+        std::string item = spec.substr(pos, comma - pos);
+        size_t eq = item.find('=');
+        if (eq == std::string::npos)
+            return false;
+        keys.push_back(item.substr(0, eq));
+        values.push_back(item.substr(eq + 1));
+        pos = comma + 1;
+    }
+    // The window comes first since the other sizes are derived from it
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (keys[i] == "w") {
+            char* end;
+            uint64_t w = strtoull(values[i].c_str(), &end, 0);
+            if (values[i].empty() || *end != '\0')
+                return false;
+            uint64_t ways = cfg.mdpt_ways;
+            uint64_t thr = cfg.pred_threshold;
+            uint64_t predictor = cfg.predictor;
+            cfg = mdsim_default_config(w);
+            cfg.mdpt_ways = ways;
+            cfg.pred_threshold = thr;
+            cfg.predictor = predictor;
+        }
+    }
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (keys[i] == "w")
+            continue;
+        if (keys[i] == "o") {
+            if (out_name)
+                *out_name = values[i];
+            continue;
+        }
+        if (keys[i] == "pred") {
+            int p = mdsim_find_predictor(values[i]);
+            if (p < 0)
+                return false;
+            cfg.predictor = p;
+            continue;
+        }
+        char* end;
+        uint64_t v = strtoull(values[i].c_str(), &end, 0);
+        if (values[i].empty() || *end != '\0')
+            return false;
+        if (keys[i] == "ibq")
+            cfg.ibq_size = v;
+        else if (keys[i] == "mdpt")
+            cfg.mdpt_size = v;
+        else if (keys[i] == "ways")
+            cfg.mdpt_ways = v;
+        else if (keys[i] == "mdst")
+            cfg.mdst_size = v;
+        else if (keys[i] == "thr")
+            cfg.pred_threshold = v;
+        else
+            return false;
+    }
+    // As with the -mdpt_size knob, 0 means the size of the IBQ
+    if (cfg.mdpt_size == 0)
+        cfg.mdpt_size = cfg.ibq_size;
+    return cfg.ibq_size > cfg.store_resolve_cycles;
+}
+
+void mdsim_stats_add(MDSimStats& a, const MDSimStats& b) {
+    a.cycles += b.cycles;
+    a.ld_ins_count += b.ld_ins_count;
+    a.st_ins_count += b.st_ins_count;
+    a.predictions += b.predictions;
+    a.mispredictions += b.mispredictions;
+    a.speculations += b.speculations;
+    a.mis_speculations += b.mis_speculations;
+    a.false_deps += b.false_deps;
+    a.ldst_buffer_time += b.ldst_buffer_time;
+}
+
+void mdsim_stats_sub(MDSimStats& a, const MDSimStats& b) {
+    a.cycles -= b.cycles;
+    a.ld_ins_count -= b.ld_ins_count;
+    a.st_ins_count -= b.st_ins_count;
+    a.predictions -= b.predictions;
+    a.mispredictions -= b.mispredictions;
+    a.speculations -= b.speculations;
+    a.mis_speculations -= b.mis_speculations;
+    a.false_deps -= b.false_deps;
+    a.ldst_buffer_time -= b.ldst_buffer_time;
+}
+
+void mdsim_report(std::ostream& out, const MDSimConfig& cfg, const MDSimStats& stats) {
+    if (cfg.predictor != 0)
+        out << "Predictor: " << mdsim_predictor(cfg.predictor).name << endl;
+    out << "Store Resolve Window: " << cfg.store_resolve_cycles << endl;
+    out << "Total Instructions: " << stats.cycles << endl;
+    out << "Total Loads: " << stats.ld_ins_count << endl;
+    out << "Total Stores: " << stats.st_ins_count << endl;
+    out << "Total MDPT Predictions: " << stats.predictions << endl;
+    out << "Total MDPT Mispredictions: " << stats.mispredictions << endl;
+    out << "Misprediction Rate: " << (double)stats.mispredictions / (double)stats.predictions << endl;
+    out << "Total Load Speculations: " << stats.speculations << endl;
+    out << "Total Load Mis-speculations: " << stats.mis_speculations << endl;
+    out << "Mis-speculation Rate: " << (double)stats.mis_speculations / (double)stats.speculations << endl;
+    out << "Total False Dependencies: "<< stats.false_deps << endl;
+    out << "Mis-speculations due to False Dependencies: " << (double)stats.false_deps / (double)stats.mis_speculations << endl;
+    out << "Avg. Time in LD/ST Buffer (Loads): " << (double) stats.ldst_buffer_time / (double) stats.ld_ins_count << endl;
+}
+
+void mdsim_csv_header(std::ostream& out) {
+    out << "predictor,window,ibq,mdpt,ways,mdst,threshold,instructions,loads,stores,"
+        << "predictions,mispredictions,misprediction_rate,speculations,mis_speculations,"
+        << "mis_speculation_rate,false_deps,avg_ldst_time" << endl;
+}
+
+void mdsim_csv_row(std::ostream& out, const MDSimConfig& cfg, const MDSimStats& stats) {
+    out << mdsim_predictor(cfg.predictor).name << ","
+        << cfg.store_resolve_cycles << "," << cfg.ibq_size << "," << cfg.mdpt_size << ","
+        << cfg.mdpt_ways << "," << cfg.mdst_size << "," << cfg.pred_threshold << ","
+        << stats.cycles << "," << stats.ld_ins_count << "," << stats.st_ins_count << ","
+        << stats.predictions << "," << stats.mispredictions << ","
+        << (double)stats.mispredictions / (double)stats.predictions << ","
+        << stats.speculations << "," << stats.mis_speculations << ","
+        << (double)stats.mis_speculations / (double)stats.speculations << ","
+        << stats.false_deps << ","
+        << (double)stats.ldst_buffer_time / (double)stats.ld_ins_count << endl;
+}
+
+MDSim::MDSim(const MDSimConfig& c) : cfg(c), profile(NULL), live(NULL) {
+    memset(&st, 0, sizeof(st));
+}
+
+void MDSim::resetStats() {
+    memset(&st, 0, sizeof(st));
+}
+
+// The IBQ model, shared by all predictors. The predictor decides how each
+// load issues and learns from the outcome; this class keeps the IBQ, resolves
+// stores a window after they enter it and catches the loads that issued too
+// early.
+template <class Predictor>
+class MDSimT : public MDSim {
+public:
+    MDSimT(const MDSimConfig& cfg);
+    ~MDSimT();
+
+    void step(uint64_t ins_addr, bool ins_st, bool ins_ld, uint64_t ea);
+    void stepNonMem(uint64_t n);
+    uint64_t stepBatch(const MDSimRecord* recs, size_t n);
+    void warm(uint64_t ins_addr, bool ins_st, bool ins_ld, uint64_t ea);
+    void warmNonMem(uint64_t n) { warm_seq += n; }
+    uint64_t warmBatch(const MDSimRecord* recs, size_t n);
+    void flush();
+    void save(std::ostream& out) const;
+    bool load(std::istream& in);
+
+    // Called back by the predictor
+    bool loadAt(uint64_t slot, uint64_t ldpc) const {
+        return (IBQ_flags[slot] & IBQ_LD) && IBQ[slot].addr == ldpc;
+    }
+    uint64_t pcAt(uint64_t slot) const { return IBQ[slot].addr; }
+    bool sameAddress(uint64_t a, uint64_t b) const { return IBQ[a].ea == IBQ[b].ea; }
+    // Whether a load that was told to wait had an older unresolved store to
+    // its address when it dispatched
+    bool waitNeeded(uint64_t slot) const { return IBQ_flags[slot] & IBQ_NEEDED; }
+    void resolveLoad(uint64_t ldid, uint64_t stid, bool dependent);
+
+private:
+    // The IBQ keeps its flags in a separate byte array, so the per-cycle
+    // resolve check and non-memory instructions only touch one byte a slot
+    struct IBQ_entry {
+        uint64_t addr;
+        uint64_t ea;
+    };
+    enum {
+        IBQ_ST = 1,
+        IBQ_LD = 2,
+        IBQ_KIND = IBQ_ST | IBQ_LD,
+        IBQ_SPECULATIVE = 4,
+        IBQ_COMMITTED = 8,
+        IBQ_NEEDED = 16     // See waitNeeded
+    };
+
+    // Last store to each effective address hash, for functional warming
+    struct Warm_entry {
+        uint64_t ea;
+        uint64_t stpc;
+        uint64_t seq;
+    };
+
+    void resolveStore(uint64_t index);
+    void dispatchLoad(uint64_t slot);
+    void dispatchStore(uint64_t slot);
+    uint64_t specBucket(uint64_t ea) const;
+    void linkSpeculative(uint64_t slot);
+    void unlinkSpeculative(uint64_t slot);
+    void clearSpeculative(uint64_t slot);
+    bool olderStoreTo(uint64_t ea) const;
+    inline void resolveWindow();
+    inline void advanceTail();
+
+    // Clock for predictor replacement. Unlike st.cycles it is never reset.
+    uint64_t now;
+
+    uint64_t uncommitted_stores;   // Keeps track of the number of uncommitted stores in IBQ
+
+    IBQ_entry* IBQ;
+    uint8_t* IBQ_flags;
+    uint64_t IBQ_tail;
+    uint64_t IBQ_count;
+
+    // Speculative loads younger than the store being resolved, hashed by
+    // effective address. This stands in for the CDB broadcast of a resolved
+    // store address. Nodes are IBQ slots; spec_prev is -2 for slots that are
+    // not in the table.
+    int32_t* spec_head;
+    int32_t* spec_next;
+    int32_t* spec_prev;
+    uint64_t spec_shift;
+    // Unresolved stores, chained the same way in buckets of the same hash
+    int32_t* store_head;
+    int32_t* store_next;
+    int32_t* store_prev;
+
+    Warm_entry* warm_st;
+    uint64_t warm_shift;
+    uint64_t warm_seq;
+
+    Predictor pred;
+};
+
+template <class Predictor>
+MDSimT<Predictor>::MDSimT(const MDSimConfig& c) : MDSim(c), pred(cfg) {
+    now = 0;
+    uncommitted_stores = 0;
+    IBQ_tail = 0;
+    IBQ_count = 0;
+    // Initialize IBQ
+    IBQ = (IBQ_entry*) calloc_lines(cfg.ibq_size, sizeof(IBQ_entry));
+    IBQ_flags = (uint8_t*) calloc_lines(cfg.ibq_size, sizeof(uint8_t));
+    // Initialize the speculative load table with at least two buckets per
+    // load that can be in the resolve window
+    uint64_t spec_buckets = 16;
+    spec_shift = 60;
+    while (spec_buckets < 2 * cfg.store_resolve_cycles) {
+        spec_buckets <<= 1;
+        spec_shift--;
+    }
+    spec_head = (int32_t*) malloc(sizeof(int32_t) * spec_buckets);
+    store_head = (int32_t*) malloc(sizeof(int32_t) * spec_buckets);
+    for (uint64_t i = 0; i < spec_buckets; i++) {
+        spec_head[i] = -1;
+        store_head[i] = -1;
+    }
+    spec_next = (int32_t*) malloc(sizeof(int32_t) * cfg.ibq_size);
+    spec_prev = (int32_t*) malloc(sizeof(int32_t) * cfg.ibq_size);
+    store_next = (int32_t*) malloc(sizeof(int32_t) * cfg.ibq_size);
+    store_prev = (int32_t*) malloc(sizeof(int32_t) * cfg.ibq_size);
+    for (uint64_t i = 0; i < cfg.ibq_size; i++) {
+        spec_prev[i] = -2;
+        store_prev[i] = -2;
+    }
+    // Initialize the functional warming table, four entries per instruction
+    // of the resolve window
+    uint64_t warm_entries = 64;
+    warm_shift = 58;
+    while (warm_entries < 4 * cfg.store_resolve_cycles) {
+        warm_entries <<= 1;
+        warm_shift--;
+    }
+    warm_st = (Warm_entry*) calloc(warm_entries, sizeof(Warm_entry));
+    warm_seq = cfg.store_resolve_cycles + 1;
+}
+
+template <class Predictor>
+MDSimT<Predictor>::~MDSimT() {
+    free(warm_st);
+    free(store_prev);
+    free(store_next);
+    free(store_head);
+    free(spec_prev);
+    free(spec_next);
+    free(spec_head);
+    free(IBQ_flags);
+    free(IBQ);
+}
+
+template <class Predictor>
+uint64_t MDSimT<Predictor>::specBucket(uint64_t ea) const {
+    return (ea * 0x9E3779B97F4A7C15ULL) >> spec_shift;
+}
+
+// Adds a slot to the front of a bucket chain, so each bucket lists the
+// youngest slots first
+static inline void chain_link(int32_t* head, int32_t* next, int32_t* prev, uint64_t bucket, uint64_t slot) {
+    prev[slot] = -1;
+    next[slot] = head[bucket];
+    if (head[bucket] >= 0)
+        prev[head[bucket]] = slot;
+    head[bucket] = slot;
+}
+
+// Removes a slot from its bucket chain, if it is in one
+static inline void chain_unlink(int32_t* head, int32_t* next, int32_t* prev, uint64_t bucket, uint64_t slot) {
+    if (prev[slot] == -2)
+        return;
+    if (prev[slot] >= 0)
+        next[prev[slot]] = next[slot];
+    else
+        head[bucket] = next[slot];
+    if (next[slot] >= 0)
+        prev[next[slot]] = prev[slot];
+    prev[slot] = -2;
+}
+
+template <class Predictor>
+void MDSimT<Predictor>::linkSpeculative(uint64_t slot) {
+    chain_link(spec_head, spec_next, spec_prev, specBucket(IBQ[slot].ea), slot);
+}
+
+template <class Predictor>
+void MDSimT<Predictor>::unlinkSpeculative(uint64_t slot) {
+    chain_unlink(spec_head, spec_next, spec_prev, specBucket(IBQ[slot].ea), slot);
+}
+
+// Whether an unresolved store, all of which are older than the instruction
+// being dispatched, writes ea
+template <class Predictor>
+bool MDSimT<Predictor>::olderStoreTo(uint64_t ea) const {
+    for (int32_t s = store_head[specBucket(ea)]; s >= 0; s = store_next[s])
+        if (IBQ[s].ea == ea)
+            return true;
+    return false;
+}
+
+// Marks a load as no longer speculative
+template <class Predictor>
+void MDSimT<Predictor>::clearSpeculative(uint64_t slot) {
+    IBQ_flags[slot] &= ~IBQ_SPECULATIVE;
+    unlinkSpeculative(slot);
+}
+
+// Commits a load that was predicted against a resolving store, given whether
+// it really depended on the store
+template <class Predictor>
+void MDSimT<Predictor>::resolveLoad(uint64_t ldid, uint64_t stid, bool dependent) {
+    const uint64_t IBQ_SIZE = cfg.ibq_size;
+    if (dependent) {
+        // True dependency found. Check for misprediction
+        if (IBQ_flags[ldid] & IBQ_SPECULATIVE) {
+            // MDPT Misprediction and Mis-speculation
+            st.mispredictions++;
+            st.mis_speculations++;
+            if (profile)
+                profile->mis_speculations.add(IBQ[ldid].addr, IBQ[stid].addr);
+            // Put the Load back through the LSQ (1 cycle penalty)
+            st.ldst_buffer_time++;
+            clearSpeculative(ldid);
+            IBQ_flags[ldid] |= IBQ_COMMITTED;
+        }
+        else {
+            // Commit the Load
+            IBQ_flags[ldid] |= IBQ_COMMITTED;
+            // Add the Load's waiting time in the LSQ
+            int time = IBQ_tail - ldid;
+            if (time < 0) {
+                time += IBQ_SIZE;
+            }
+            st.ldst_buffer_time += time;
+        }
+    }
+    else {
+        // False dependency found. Check for misprediction
+        if (!(IBQ_flags[ldid] & IBQ_SPECULATIVE)) {
+            st.mispredictions++;
+            st.false_deps++;
+            if (profile)
+                profile->false_deps.add(IBQ[ldid].addr, IBQ[stid].addr);
+            // Commit the Load
+            IBQ_flags[ldid] |= IBQ_COMMITTED;
+            // Add the Load's waiting time in the LSQ
+            int time = IBQ_tail - ldid;
+            if (time < 0) {
+                time += IBQ_SIZE;
+            }
+            st.ldst_buffer_time += time;
+        }
+        else {
+            // If it was speculative, just mark it as committed
+            clearSpeculative(ldid);
+            IBQ_flags[ldid] |= IBQ_COMMITTED;
+        }
+    }
+}
+
+// Commits the store at IBQ slot index once its address is resolved
+template <class Predictor>
+void MDSimT<Predictor>::resolveStore(uint64_t index) {
+    const uint64_t IBQ_SIZE = cfg.ibq_size;
+    // Should be committed
+    IBQ_flags[index] |= IBQ_COMMITTED;
+    uncommitted_stores--;
+    chain_unlink(store_head, store_next, store_prev, specBucket(IBQ[index].ea), index);
+    // Resolve the loads that were predicted against this store
+    pred.resolveStore(*this, index, now);
+    // Now we need to find uncaught Load conflicts among the speculative loads
+    // younger than this store. Loads are visited youngest first.
+    int32_t next;
+    for (int32_t jindex = spec_head[specBucket(IBQ[index].ea)]; jindex >= 0; jindex = next) {
+        next = spec_next[jindex];
+        if (IBQ[jindex].ea == IBQ[index].ea) {
+            // Found a Load conflict the predictor did not catch
+            // Mis-speculation
+            st.mis_speculations++;
+            if (profile)
+                profile->mis_speculations.add(IBQ[jindex].addr, IBQ[index].addr);
+            // Commit the Load
+            IBQ_flags[jindex] |= IBQ_COMMITTED;
+            clearSpeculative(jindex);
+            st.ldst_buffer_time++;
+            // Train the predictor
+            int diff = jindex - index;
+            if (diff < 0)
+                diff = diff + IBQ_SIZE;
+            pred.violation(IBQ[jindex].addr, IBQ[index].addr, diff, now);
+        }
+    }
+}
+
+// Asks the predictor how a new load issues
+template <class Predictor>
+void MDSimT<Predictor>::dispatchLoad(uint64_t slot) {
+    uint8_t& flags = IBQ_flags[slot];
+    st.ld_ins_count++;
+    switch (pred.dispatchLoad(slot, IBQ[slot].addr, now)) {
+        case LOAD_FREE:
+            // No known dependency. We always predict no dependency here
+            // If there are uncommitted stores in the IBQ, then we speculate
+            if (uncommitted_stores > 0) {
+                st.speculations++;
+                flags = (flags & IBQ_KIND) | IBQ_SPECULATIVE;
+                st.ldst_buffer_time++;
+            }
+            else {
+                // No uncommitted stores, so this load is fully committed (no speculation)
+                flags = (flags & IBQ_KIND) | IBQ_COMMITTED;
+                st.ldst_buffer_time++;
+            }
+            break;
+        case LOAD_READY:
+            flags = (flags & IBQ_KIND) | IBQ_COMMITTED;
+            st.ldst_buffer_time++;
+            break;
+        case LOAD_SPECULATE:
+            // Predict no dependency (speculate)
+            st.predictions++;
+            st.speculations++;
+            flags = (flags & IBQ_KIND) | IBQ_SPECULATIVE;
+            st.ldst_buffer_time++;
+            break;
+        case LOAD_WAIT:
+            // Predict dependency
+            st.predictions++;
+            flags = flags & IBQ_KIND;
+            if (olderStoreTo(IBQ[slot].ea))
+                flags |= IBQ_NEEDED;
+            break;
+    }
+}
+
+template <class Predictor>
+void MDSimT<Predictor>::dispatchStore(uint64_t slot) {
+    st.st_ins_count++;
+    uncommitted_stores++;
+    IBQ_flags[slot] &= IBQ_KIND;
+    chain_link(store_head, store_next, store_prev, specBucket(IBQ[slot].ea), slot);
+    pred.dispatchStore(slot, IBQ[slot].addr);
+}
+
+// Resolves the store (if any) that entered the IBQ a window ago
+template <class Predictor>
+inline void MDSimT<Predictor>::resolveWindow() {
+    // Check to see if previous stores have been resolved
+    // We only check if its been STORE_RESOLVE_CYCLES since a store has entered IBQ
+    if (IBQ_count >= cfg.store_resolve_cycles) {
+        int index = IBQ_tail - cfg.store_resolve_cycles;
+        if (index < 0) {
+            index = index + cfg.ibq_size;
+        }
+        // A load this old can no longer be caught by a resolving store
+        unlinkSpeculative(index);
+        // Look for uncommitted store
+        if ((IBQ_flags[index] & IBQ_ST) && !(IBQ_flags[index] & IBQ_COMMITTED))
+            resolveStore(index);
+    }
+}
+
+template <class Predictor>
+inline void MDSimT<Predictor>::advanceTail() {
+    IBQ_tail++;
+    if (IBQ_tail >= cfg.ibq_size)
+        IBQ_tail = 0;
+    if (IBQ_count < cfg.ibq_size)
+        IBQ_count++;
+}
+
+template <class Predictor>
+void MDSimT<Predictor>::step(uint64_t ins_addr, bool ins_st, bool ins_ld, uint64_t ea) {
+    st.cycles++;
+    now++;
+
+    resolveWindow();
+
+    // Retire the top most instruction in the IBQ (if the IBQ is full) before
+    // its slot is reused
+    if (IBQ_count >= cfg.ibq_size)
+        pred.retireSlot(IBQ_tail);
+
+    // Create a new IBQ entry
+    IBQ[IBQ_tail].addr = ins_addr;
+    IBQ[IBQ_tail].ea = ea;
+    IBQ_flags[IBQ_tail] = (ins_st ? IBQ_ST : 0) | (ins_ld ? IBQ_LD : 0) | IBQ_COMMITTED;
+
+    // If the instruction was a load, we have to search for potential store dependencies
+    if (ins_ld)
+        dispatchLoad(IBQ_tail);
+
+    // If the instruction is a store, we have to search for potential load dependencies
+    if (ins_st)
+        dispatchStore(IBQ_tail);
+
+    if (IBQ_flags[IBQ_tail] & IBQ_SPECULATIVE)
+        linkSpeculative(IBQ_tail);
+    advanceTail();
+}
+
+template <class Predictor>
+void MDSimT<Predictor>::stepNonMem(uint64_t n) {
+    for (; n > 0; n--) {
+        st.cycles++;
+        now++;
+        resolveWindow();
+        if (IBQ_count >= cfg.ibq_size)
+            pred.retireSlot(IBQ_tail);
+        IBQ_flags[IBQ_tail] = IBQ_COMMITTED;
+        advanceTail();
+    }
+}
+
+// The qualified calls below are not virtual
+template <class Predictor>
+uint64_t MDSimT<Predictor>::stepBatch(const MDSimRecord* recs, size_t n) {
+    uint64_t count = 0;
+    for (size_t i = 0; i < n; i++) {
+        const MDSimRecord& r = recs[i];
+        MDSimT::stepNonMem(r.nonmem);
+        count += r.nonmem;
+        if (r.ld || r.st) {
+            MDSimT::step(r.pc, r.st, r.ld, r.ea);
+            count++;
+        }
+    }
+    if (live)
+        live->publish(st);
+    return count;
+}
+
+template <class Predictor>
+void MDSimT<Predictor>::warm(uint64_t ins_addr, bool ins_st, bool ins_ld, uint64_t ea) {
+    warm_seq++;
+    now++;
+    Warm_entry& w = warm_st[(ea * 0x9E3779B97F4A7C15ULL) >> warm_shift];
+    // The store would still be unresolved when the load dispatched
+    if (ins_ld && w.seq != 0 && w.ea == ea && warm_seq - w.seq <= cfg.store_resolve_cycles)
+        pred.warm(ins_addr, w.stpc, warm_seq - w.seq, now);
+    if (ins_st) {
+        w.ea = ea;
+        w.stpc = ins_addr;
+        w.seq = warm_seq;
+    }
+}
+
+template <class Predictor>
+uint64_t MDSimT<Predictor>::warmBatch(const MDSimRecord* recs, size_t n) {
+    uint64_t count = 0;
+    for (size_t i = 0; i < n; i++) {
+        const MDSimRecord& r = recs[i];
+        warm_seq += r.nonmem;
+        count += r.nonmem;
+        if (r.ld || r.st) {
+            MDSimT::warm(r.pc, r.st, r.ld, r.ea);
+            count++;
+        }
+    }
+    return count;
+}
+
+template <class Predictor>
+void MDSimT<Predictor>::flush() {
+    for (uint64_t i = 0; i < cfg.ibq_size; i++) {
+        unlinkSpeculative(i);
+        chain_unlink(store_head, store_next, store_prev, specBucket(IBQ[i].ea), i);
+        pred.retireSlot(i);
+        IBQ_flags[i] = IBQ_COMMITTED;
+    }
+    uncommitted_stores = 0;
+    IBQ_count = 0;
+    // Stores seen before this point are too old to conflict with warmed loads
+    warm_seq += cfg.store_resolve_cycles + 1;
+}
+
+template <class Predictor>
+void MDSimT<Predictor>::save(std::ostream& out) const {
+    ckpt_put(out, &cfg, sizeof(cfg));
+    ckpt_put(out, &st, sizeof(st));
+    ckpt_put(out, &now, sizeof(now));
+    ckpt_put(out, &uncommitted_stores, sizeof(uncommitted_stores));
+    ckpt_put(out, IBQ, sizeof(IBQ_entry) * cfg.ibq_size);
+    ckpt_put(out, IBQ_flags, sizeof(uint8_t) * cfg.ibq_size);
+    ckpt_put(out, &IBQ_tail, sizeof(IBQ_tail));
+    ckpt_put(out, &IBQ_count, sizeof(IBQ_count));
+    ckpt_put(out, spec_head, sizeof(int32_t) << (64 - spec_shift));
+    ckpt_put(out, spec_next, sizeof(int32_t) * cfg.ibq_size);
+    ckpt_put(out, spec_prev, sizeof(int32_t) * cfg.ibq_size);
+    ckpt_put(out, store_head, sizeof(int32_t) << (64 - spec_shift));
+    ckpt_put(out, store_next, sizeof(int32_t) * cfg.ibq_size);
+    ckpt_put(out, store_prev, sizeof(int32_t) * cfg.ibq_size);
+    ckpt_put(out, warm_st, sizeof(Warm_entry) << (64 - warm_shift));
+    ckpt_put(out, &warm_seq, sizeof(warm_seq));
+    pred.save(out);
+}
+
+template <class Predictor>
+bool MDSimT<Predictor>::load(std::istream& in) {
+    MDSimConfig c;
+    if (!ckpt_get(in, &c, sizeof(c)) || memcmp(&c, &cfg, sizeof(c)) != 0)
+        return false;
+    return ckpt_get(in, &st, sizeof(st)) &&
+           ckpt_get(in, &now, sizeof(now)) &&
+           ckpt_get(in, &uncommitted_stores, sizeof(uncommitted_stores)) &&
+           ckpt_get(in, IBQ, sizeof(IBQ_entry) * cfg.ibq_size) &&
+           ckpt_get(in, IBQ_flags, sizeof(uint8_t) * cfg.ibq_size) &&
+           ckpt_get(in, &IBQ_tail, sizeof(IBQ_tail)) &&
+           ckpt_get(in, &IBQ_count, sizeof(IBQ_count)) &&
+           ckpt_get(in, spec_head, sizeof(int32_t) << (64 - spec_shift)) &&
+           ckpt_get(in, spec_next, sizeof(int32_t) * cfg.ibq_size) &&
+           ckpt_get(in, spec_prev, sizeof(int32_t) * cfg.ibq_size) &&
+           ckpt_get(in, store_head, sizeof(int32_t) << (64 - spec_shift)) &&
+           ckpt_get(in, store_next, sizeof(int32_t) * cfg.ibq_size) &&
+           ckpt_get(in, store_prev, sizeof(int32_t) * cfg.ibq_size) &&
+           ckpt_get(in, warm_st, sizeof(Warm_entry) << (64 - warm_shift)) &&
+           ckpt_get(in, &warm_seq, sizeof(warm_seq)) &&
+           pred.load(in);
+}
+
+template <class Predictor>
+static MDSim* create(const MDSimConfig& cfg) {
+    return new MDSimT<Predictor>(cfg);
+}
+
+// The predictor registry. Index 0 is the default.
+struct MDPredictorEntry {
+    MDPredictorInfo info;
+    MDSim* (*create)(const MDSimConfig& cfg);
+};
+
+static const MDPredictorEntry predictors[] = {
+    { { "mdpt", "MDPT/MDST with 2-bit up/down counters" },
+      create<MDPTPredictor<UpDownCounter<2> > > },
+    { { "mdpt1", "MDPT/MDST with 1-bit counters" },
+      create<MDPTPredictor<UpDownCounter<1> > > },
+    { { "mdpt3", "MDPT/MDST with 3-bit up/down counters" },
+      create<MDPTPredictor<UpDownCounter<3> > > },
+    { { "storeset", "store sets: SSIT (mdpt entries) and LFST (mdst sets)" },
+      create<StoreSetPredictor> },
+    { { "waitbit", "21264 style wait table (mdpt entries)" },
+      create<WaitBitPredictor> },
+};
+
+MDSim* mdsim_create(const MDSimConfig& cfg) {
+    if (cfg.predictor >= mdsim_predictor_count())
+        return NULL;
+    return predictors[cfg.predictor].create(cfg);
+}
+
+size_t mdsim_predictor_count() {
+    return sizeof(predictors) / sizeof(predictors[0]);
+}
+
+const MDPredictorInfo& mdsim_predictor(size_t i) {
+    return predictors[i].info;
+}
+
+int mdsim_find_predictor(const std::string& name) {
+    for (size_t i = 0; i < mdsim_predictor_count(); i++)
+        if (name == predictors[i].info.name)
+            return i;
+    return -1;
+}
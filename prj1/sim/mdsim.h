@@ -0,0 +1,142 @@
+#ifndef _MDSIM_H_
+#define _MDSIM_H_
+
+#include <stdint.h>
+#include <istream>
+#include <ostream>
+#include <string>
+
+// Memory dependence simulator core.
+// This file has no dependency on Pin, so the same model can be driven by the
+// loadStore pintool or by the native replay tool. The IBQ model is shared by
+// all dependence predictors; the predictor itself is a compile-time policy
+// (see predictors.h) picked by name from a registry at run time.
+
+struct MDSimConfig {
+    uint64_t store_resolve_cycles;  // Cycles until a store's address is resolved
+    uint64_t ibq_size;              // Must be larger than store_resolve_cycles
+    uint64_t mdpt_size;
+    uint64_t mdpt_ways;     // MDPT associativity (mdpt_size for fully associative)
+    uint64_t mdst_size;
+    uint64_t pred_threshold;    // Loads speculate while the MDPT counter is below this
+    uint64_t predictor;         // Index in the predictor registry (0 is the MDPT/MDST)
+};
+
+// Builds the default configuration for a Store Resolution Window.
+// The IBQ is sized to the next power of two above twice the window, and the
+// MDPT/MDST are the same size as the IBQ. The MDPT is 4-way set associative,
+// and loads speculate while their predictor is below 2.
+MDSimConfig mdsim_default_config(uint64_t store_resolve_cycles);
+
+// Applies a comma separated list of key=value settings to cfg, e.g.
+// "w=20,mdpt=256,ways=8,o=loadStore_20.out". Keys are w (window, which also
+// resets the derived sizes), ibq, mdpt, ways, mdst, thr (predictor threshold),
+// pred (predictor name) and o (output file, stored in out_name if it is not
+// NULL). Returns false on an unknown key or a bad value.
+bool mdsim_parse_config(const std::string& spec, MDSimConfig& cfg, std::string* out_name);
+
+struct MDSimStats {
+    uint64_t cycles;
+    uint64_t ld_ins_count;
+    uint64_t st_ins_count;
+    uint64_t predictions;
+    uint64_t mispredictions;
+    uint64_t speculations;
+    uint64_t mis_speculations;
+    uint64_t false_deps;
+    uint64_t ldst_buffer_time;
+};
+
+// Adds the counters of b to a
+void mdsim_stats_add(MDSimStats& a, const MDSimStats& b);
+// Subtracts the counters of b from a
+void mdsim_stats_sub(MDSimStats& a, const MDSimStats& b);
+
+// Writes the statistics in the loadStore.out format
+void mdsim_report(std::ostream& out, const MDSimConfig& cfg, const MDSimStats& stats);
+
+// Writes the statistics as one CSV row, with the configuration first
+void mdsim_csv_header(std::ostream& out);
+void mdsim_csv_row(std::ostream& out, const MDSimConfig& cfg, const MDSimStats& stats);
+
+// One memory instruction and the run of non-memory instructions before it,
+// the unit of MDSim::stepBatch
+struct MDSimRecord {
+    uint64_t nonmem;    // Non-memory instructions before this one
+    uint64_t pc;
+    uint64_t ea;
+    bool ld;
+    bool st;            // A record with neither ld nor st only carries nonmem
+};
+
+struct MDPairProfile;
+struct MDLiveSlot;
+
+class MDSim {
+public:
+    virtual ~MDSim() {}
+
+    // Simulates one dynamic instruction
+    virtual void step(uint64_t ins_addr, bool ins_st, bool ins_ld, uint64_t ea) = 0;
+    // Simulates a run of n non-memory instructions
+    virtual void stepNonMem(uint64_t n) = 0;
+    // Simulates a batch of records in order. Returns the number of
+    // instructions simulated. This is the entry point to use on hot paths,
+    // since it costs one virtual call per batch.
+    virtual uint64_t stepBatch(const MDSimRecord* recs, size_t n) = 0;
+
+    const MDSimConfig& config() const { return cfg; }
+    const MDSimStats& stats() const { return st; }
+    // Zeroes the counters but keeps the IBQ and predictor state, e.g. after a
+    // warm-up period
+    void resetStats();
+    // Attributes mis-speculations and false dependencies to their load/store
+    // PC pairs in profile (not owned), or stops doing so if it is NULL
+    void setProfile(MDPairProfile* p) { profile = p; }
+    // Publishes the counters to slot (not owned) after every batch, see
+    // live.h, or stops doing so if it is NULL
+    void setLive(MDLiveSlot* slot) { live = slot; }
+
+    // Functional warming: trains the predictor on loads that read the address
+    // of a store less than a window earlier, as a mis-speculation would,
+    // without modelling the IBQ or counting statistics
+    virtual void warm(uint64_t ins_addr, bool ins_st, bool ins_ld, uint64_t ea) = 0;
+    virtual void warmNonMem(uint64_t n) = 0;
+    // Same over a batch of records. Returns the number of instructions.
+    virtual uint64_t warmBatch(const MDSimRecord* recs, size_t n) = 0;
+    // Drops the instructions in flight, e.g. before fast-forwarding
+    virtual void flush() = 0;
+
+    // Writes the IBQ, predictor tables and counters as a raw image (see
+    // checkpoint.h). load reads one back into a simulator of the same
+    // configuration, and returns false if the image does not match.
+    virtual void save(std::ostream& out) const = 0;
+    virtual bool load(std::istream& in) = 0;
+
+protected:
+    MDSim(const MDSimConfig& cfg);
+
+    MDSimConfig cfg;
+    MDSimStats st;
+    MDPairProfile* profile;
+    MDLiveSlot* live;
+
+private:
+    MDSim(const MDSim&);
+    MDSim& operator=(const MDSim&);
+};
+
+// Creates a simulator with the predictor selected by cfg.predictor
+MDSim* mdsim_create(const MDSimConfig& cfg);
+
+// Predictor registry
+struct MDPredictorInfo {
+    const char* name;
+    const char* description;
+};
+size_t mdsim_predictor_count();
+const MDPredictorInfo& mdsim_predictor(size_t i);
+// Returns the registry index of a predictor name, or -1
+int mdsim_find_predictor(const std::string& name);
+
+#endif
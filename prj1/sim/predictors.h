@@ -0,0 +1,646 @@
+#ifndef _PREDICTORS_H_
+#define _PREDICTORS_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mdsim.h"
+
+// Dependence predictor policies for the IBQ model in mdsim.cpp.
+//
+// The model is a template over its predictor, so every call below is resolved
+// at compile time. A predictor provides:
+//
+//     P(MDSimConfig& cfg)     may adjust cfg (e.g. the effective associativity)
+//     MDLoadDecision dispatchLoad(uint64_t slot, uint64_t ldpc, uint64_t now)
+//     void dispatchStore(uint64_t slot, uint64_t stpc)
+//     template <class Sim> void resolveStore(Sim& sim, uint64_t slot, uint64_t now)
+//         calls sim.resolveLoad(load_slot, slot, dependent) for every load
+//         that was predicted against this store. sim.waitNeeded(load_slot)
+//         tells whether a waiting load had any older unresolved store to its
+//         address when it dispatched.
+//     void violation(uint64_t ldpc, uint64_t stpc, uint64_t dist, uint64_t now)
+//         a load issued before an older store to the same address
+//     void warm(uint64_t ldpc, uint64_t stpc, uint64_t dist, uint64_t now)
+//         functional warming, see MDSim::warm
+//     void retireSlot(uint64_t slot)
+//         an IBQ slot is about to be reused
+//     void save(std::ostream& out) const, bool load(std::istream& in)
+//         checkpointing, see MDSim::save
+//
+// Slots are IBQ indices and dist is the number of instructions from the store
+// to the load. New predictors are added to the registry in mdsim.cpp.
+
+// How a load issues
+enum MDLoadDecision {
+    LOAD_FREE,      // No known dependence: speculates if any store is unresolved
+    LOAD_READY,     // The store it depends on has already resolved
+    LOAD_SPECULATE, // Predicted independent of an unresolved store
+    LOAD_WAIT       // Predicted dependent on an unresolved store
+};
+
+// Maps a PC onto [0, n) with a multiplicative hash
+static inline uint64_t pc_hash(uint64_t pc, uint64_t n) {
+    uint64_t h = (pc * 0x9E3779B97F4A7C15ULL) >> 32;
+    return (h * n) >> 32;
+}
+
+// Allocates a zeroed array aligned to a cache line
+static inline void* calloc_lines(size_t n, size_t size) {
+    void* p;
+    size_t bytes = n * size > 0 ? n * size : 1;
+    if (posix_memalign(&p, 64, bytes) != 0)
+        return NULL;
+    memset(p, 0, bytes);
+    return p;
+}
+
+// Checkpoint images are raw copies of the tables, read back by the same build
+static inline void ckpt_put(std::ostream& out, const void* p, size_t bytes) {
+    out.write((const char*) p, bytes);
+}
+
+static inline bool ckpt_get(std::istream& in, void* p, size_t bytes) {
+    in.read((char*) p, bytes);
+    return (size_t) in.gcount() == bytes;
+}
+
+// Saturating up/down counter of the given width. A new MDPT entry starts at 1.
+template <unsigned Bits>
+struct UpDownCounter {
+    static const uint8_t MAX = (1 << Bits) - 1;
+    static const uint8_t INITIAL = 1;
+    static void strengthen(uint8_t& c) {
+        if (c < MAX)
+            c++;
+    }
+    static void weaken(uint8_t& c) {
+        if (c > 0)
+            c--;
+    }
+};
+
+// Loads waiting on each in-flight store, chained through the load slots
+class MDWaitLists {
+public:
+    MDWaitLists(uint64_t n) : slots(n) {
+        head = (int32_t*) malloc(sizeof(int32_t) * slots);
+        next = (int32_t*) malloc(sizeof(int32_t) * slots);
+        for (uint64_t i = 0; i < slots; i++)
+            head[i] = -1;
+    }
+    ~MDWaitLists() {
+        free(next);
+        free(head);
+    }
+
+    void add(uint64_t store, uint64_t load) {
+        next[load] = head[store];
+        head[store] = load;
+    }
+    void clear(uint64_t store) { head[store] = -1; }
+    // Resolves the loads waiting on a store. A wait was needed if any older
+    // store was still unresolved at the load's address, not only this one.
+    template <class Sim>
+    void resolve(Sim& sim, uint64_t store) {
+        for (int32_t l = head[store]; l >= 0; l = next[l])
+            sim.resolveLoad(l, store, sim.waitNeeded(l));
+        head[store] = -1;
+    }
+
+    void save(std::ostream& out) const {
+        ckpt_put(out, head, sizeof(int32_t) * slots);
+        ckpt_put(out, next, sizeof(int32_t) * slots);
+    }
+    bool load(std::istream& in) {
+        return ckpt_get(in, head, sizeof(int32_t) * slots) &&
+               ckpt_get(in, next, sizeof(int32_t) * slots);
+    }
+
+private:
+    MDWaitLists(const MDWaitLists&);
+    MDWaitLists& operator=(const MDWaitLists&);
+
+    uint64_t slots;
+    int32_t* head;
+    int32_t* next;
+};
+
+// The Moshovos MDPT/MDST. The MDPT remembers (load PC, store PC, distance)
+// triples with a confidence counter; the MDST holds one entry per in-flight
+// store instance the MDPT expects a load for, chained per IBQ slot.
+template <class Counter>
+class MDPTPredictor {
+public:
+    MDPTPredictor(MDSimConfig& cfg) : ibq_size(cfg.ibq_size) {
+        // A threshold above the counter range would never wait
+        if (cfg.pred_threshold > Counter::MAX)
+            cfg.pred_threshold = Counter::MAX;
+        threshold = cfg.pred_threshold;
+        // Initialize MDPT
+        if (cfg.mdpt_ways == 0 || cfg.mdpt_ways > cfg.mdpt_size)
+            cfg.mdpt_ways = cfg.mdpt_size;
+        ways = cfg.mdpt_ways;
+        mdpt_sets = cfg.mdpt_size / cfg.mdpt_ways;
+        mdpt_entries = mdpt_sets * cfg.mdpt_ways;
+        // Report the entries actually simulated when the size is not a
+        // multiple of the ways
+        cfg.mdpt_size = mdpt_entries;
+        MDPT = (MDPT_entry*) calloc_lines(mdpt_entries, sizeof(MDPT_entry));
+        mdpt_st_head = (int32_t*) malloc(sizeof(int32_t) * mdpt_entries);
+        mdpt_st_next = (int32_t*) malloc(sizeof(int32_t) * mdpt_entries);
+        mdpt_st_prev = (int32_t*) malloc(sizeof(int32_t) * mdpt_entries);
+        for (uint64_t i = 0; i < mdpt_entries; i++)
+            mdpt_st_head[i] = -1;
+        // Initialize MDST
+        mdst_size = cfg.mdst_size;
+        MDST = (MDST_entry*) calloc_lines(cfg.mdst_size, sizeof(MDST_entry));
+        for (uint64_t i = 0; i < cfg.mdst_size; i++)
+            MDST[i].next = i + 1 < cfg.mdst_size ? i + 1 : -1;
+        mdst_free = cfg.mdst_size > 0 ? 0 : -1;
+        mdst_head = (int32_t*) malloc(sizeof(int32_t) * ibq_size);
+        mdst_tail = (int32_t*) malloc(sizeof(int32_t) * ibq_size);
+        for (uint64_t i = 0; i < ibq_size; i++) {
+            mdst_head[i] = -1;
+            mdst_tail[i] = -1;
+        }
+    }
+
+    ~MDPTPredictor() {
+        free(mdst_tail);
+        free(mdst_head);
+        free(MDST);
+        free(mdpt_st_prev);
+        free(mdpt_st_next);
+        free(mdpt_st_head);
+        free(MDPT);
+    }
+
+    // Searches for potential store dependencies of a new load in the MDPT
+    MDLoadDecision dispatchLoad(uint64_t slot, uint64_t ldpc, uint64_t now) {
+        // Look in the load PC's MDPT set for historic store conflicts
+        MDPT_entry* mdpt = findMDPTEntry(ldpc);
+        if (mdpt == 0)
+            return LOAD_FREE;
+        // Find the corresponding MDST entry in the list of the store
+        // instance the dependency distance points at
+        int st_index = slot - mdpt->dist;
+        if (st_index < 0)
+            st_index = st_index + ibq_size;
+        int32_t j = mdst_head[st_index];
+        for (; j >= 0; j = MDST[j].next)
+            if (MDST[j].ldpc == mdpt->ldpc && MDST[j].stpc == mdpt->stpc && MDST[j].ldid == ibq_size)
+                break;
+        // The store never made it to the pipeline. No need to speculate
+        if (j < 0)
+            return LOAD_READY;
+        // Found the entry. Add the load ID
+        MDST[j].ldid = slot;
+        // If the store has already committed, then no need to predict
+        if (MDST[j].fe)
+            return LOAD_READY;
+        // Predict whether there is a dependency
+        return mdpt->pred < threshold ? LOAD_SPECULATE : LOAD_WAIT;
+    }
+
+    // Searches for potential load dependencies of a new store in the MDPT
+    void dispatchStore(uint64_t slot, uint64_t stpc) {
+        // Walk the store PC's bucket, looking for previous load conflicts
+        for (int32_t i = mdpt_st_head[mdptStoreBucket(stpc)]; i >= 0; i = mdpt_st_next[i]) {
+            if (MDPT[i].stpc == stpc) {
+                // Found a previous conflict. Make a new MDST entry if one is free
+                int32_t j = mdst_free;
+                if (j < 0)
+                    break;
+                mdst_free = MDST[j].next;
+                MDST[j].ldpc = MDPT[i].ldpc;
+                MDST[j].stpc = MDPT[i].stpc;
+                MDST[j].ldid = ibq_size;
+                MDST[j].fe = false;
+                MDST[j].next = -1;
+
+                // Append it to the list of this store's IBQ slot
+                if (mdst_tail[slot] >= 0)
+                    MDST[mdst_tail[slot]].next = j;
+                else
+                    mdst_head[slot] = j;
+                mdst_tail[slot] = j;
+            }
+        }
+    }
+
+    // Updates the MDST entries of a resolving store and the MDPT entries of
+    // the loads that were predicted against it
+    template <class Sim>
+    void resolveStore(Sim& sim, uint64_t index, uint64_t now) {
+        for (int32_t j = mdst_head[index]; j >= 0; j = MDST[j].next) {
+            // Mark the entry as complete
+            MDST[j].fe = true;
+            // Make sure the entry was actually used
+            uint64_t ldid = MDST[j].ldid;
+            if (ldid < ibq_size && sim.loadAt(ldid, MDST[j].ldpc)) {
+                // Find the corresponding MDPT table entry for updating
+                // (it may have been replaced since the load was predicted)
+                MDPT_entry* mdpt = findMDPTEntry(MDST[j].ldpc, sim.pcAt(index));
+                bool dependent = sim.sameAddress(ldid, index);
+                if (mdpt) {
+                    mdpt->last_access = now;
+                    if (dependent)
+                        Counter::strengthen(mdpt->pred);
+                    else
+                        Counter::weaken(mdpt->pred);
+                }
+                sim.resolveLoad(ldid, index, dependent);
+            }
+        }
+    }
+
+    // Makes a new MDPT entry for a mis-speculated load
+    void violation(uint64_t ldpc, uint64_t stpc, uint64_t dist, uint64_t now) {
+        MDPT_entry mdpt;
+        mdpt.valid = true;
+        mdpt.ldpc = ldpc;
+        mdpt.stpc = stpc;
+        mdpt.dist = dist;
+        mdpt.pred = Counter::INITIAL;
+        mdpt.last_access = now;
+        insertMDPTEntry(mdpt);
+    }
+
+    void warm(uint64_t ldpc, uint64_t stpc, uint64_t dist, uint64_t now) {
+        MDPT_entry* mdpt = findMDPTEntry(ldpc);
+        if (mdpt == 0) {
+            // The load would have mis-speculated
+            violation(ldpc, stpc, dist, now);
+        }
+        else if (mdpt->stpc == stpc && mdpt->dist == dist) {
+            // The predicted dependence was a true one
+            mdpt->last_access = now;
+            Counter::strengthen(mdpt->pred);
+        }
+    }
+
+    // Returns the MDST entries of the store leaving an IBQ slot to the free list
+    void retireSlot(uint64_t slot) {
+        if (mdst_head[slot] < 0)
+            return;
+        MDST[mdst_tail[slot]].next = mdst_free;
+        mdst_free = mdst_head[slot];
+        mdst_head[slot] = -1;
+        mdst_tail[slot] = -1;
+    }
+
+    void save(std::ostream& out) const {
+        ckpt_put(out, MDPT, sizeof(MDPT_entry) * mdpt_entries);
+        ckpt_put(out, mdpt_st_head, sizeof(int32_t) * mdpt_entries);
+        ckpt_put(out, mdpt_st_next, sizeof(int32_t) * mdpt_entries);
+        ckpt_put(out, mdpt_st_prev, sizeof(int32_t) * mdpt_entries);
+        ckpt_put(out, MDST, sizeof(MDST_entry) * mdst_size);
+        ckpt_put(out, mdst_head, sizeof(int32_t) * ibq_size);
+        ckpt_put(out, mdst_tail, sizeof(int32_t) * ibq_size);
+        ckpt_put(out, &mdst_free, sizeof(mdst_free));
+    }
+
+    bool load(std::istream& in) {
+        return ckpt_get(in, MDPT, sizeof(MDPT_entry) * mdpt_entries) &&
+               ckpt_get(in, mdpt_st_head, sizeof(int32_t) * mdpt_entries) &&
+               ckpt_get(in, mdpt_st_next, sizeof(int32_t) * mdpt_entries) &&
+               ckpt_get(in, mdpt_st_prev, sizeof(int32_t) * mdpt_entries) &&
+               ckpt_get(in, MDST, sizeof(MDST_entry) * mdst_size) &&
+               ckpt_get(in, mdst_head, sizeof(int32_t) * ibq_size) &&
+               ckpt_get(in, mdst_tail, sizeof(int32_t) * ibq_size) &&
+               ckpt_get(in, &mdst_free, sizeof(mdst_free));
+    }
+
+private:
+    // 32 bytes, so a 4-way set spans two cache lines
+    struct MDPT_entry {
+        uint64_t ldpc;    // Load PC
+        uint64_t stpc;    // Store PC
+        uint64_t last_access;     // Tracks last access cycle for LRU replacement strategy
+        uint32_t dist;    // Dependency distance
+        uint8_t pred;     // Up/down predictor
+        bool valid;       // Valid flag
+    };
+
+    // The store ID is the IBQ slot whose list holds the entry. 32 bytes.
+    struct MDST_entry {
+        uint64_t ldpc;    // Load PC
+        uint64_t stpc;    // Store PC
+        uint32_t ldid;    // Load ID
+        int32_t next;     // Next entry of the same store, or of the free list
+        bool fe;          // Full/Empty flag
+    };
+
+    MDPTPredictor(const MDPTPredictor&);
+    MDPTPredictor& operator=(const MDPTPredictor&);
+
+    uint64_t mdptSet(uint64_t ldpc) const {
+        return pc_hash(ldpc, mdpt_sets);
+    }
+
+    uint64_t mdptStoreBucket(uint64_t stpc) const {
+        return pc_hash(stpc, mdpt_entries);
+    }
+
+    // Finds the first MDPT entry for a load PC
+    MDPT_entry* findMDPTEntry(uint64_t ldpc) {
+        MDPT_entry* set = &MDPT[mdptSet(ldpc) * ways];
+        for (uint64_t w = 0; w < ways; w++)
+            if (set[w].valid && set[w].ldpc == ldpc)
+                return &set[w];
+        return 0;
+    }
+
+    // Finds the MDPT entry for a load/store PC pair
+    MDPT_entry* findMDPTEntry(uint64_t ldpc, uint64_t stpc) {
+        MDPT_entry* set = &MDPT[mdptSet(ldpc) * ways];
+        for (uint64_t w = 0; w < ways; w++)
+            if (set[w].valid && set[w].ldpc == ldpc && set[w].stpc == stpc)
+                return &set[w];
+        return 0;
+    }
+
+    // Allocates the next available MDPT entry in a set
+    uint64_t allocateNewMDPTEntry(uint64_t set) {
+        // Search for the first invalid entry, or the lease recently used entry
+        uint64_t first = set * ways;
+        uint64_t lru = first;
+        uint64_t lru_last_access = MDPT[first].last_access;
+        for (uint64_t i = first; i < first + ways; i++) {
+            // Invalid entry found. Return its index
+            if (!MDPT[i].valid)
+                return(i);
+            if (MDPT[i].last_access < lru_last_access) {
+                lru_last_access = MDPT[i].last_access;
+                lru = i;
+            }
+        }
+        // No invalid entries found. Return the least recently used entry
+        return (lru);
+    }
+
+    // Writes a new MDPT entry and moves it to its store PC bucket
+    void insertMDPTEntry(const MDPT_entry& mdpt) {
+        int32_t i = allocateNewMDPTEntry(mdptSet(mdpt.ldpc));
+        if (MDPT[i].valid) {
+            // Unlink the replaced entry
+            if (mdpt_st_prev[i] >= 0)
+                mdpt_st_next[mdpt_st_prev[i]] = mdpt_st_next[i];
+            else
+                mdpt_st_head[mdptStoreBucket(MDPT[i].stpc)] = mdpt_st_next[i];
+            if (mdpt_st_next[i] >= 0)
+                mdpt_st_prev[mdpt_st_next[i]] = mdpt_st_prev[i];
+        }
+        MDPT[i] = mdpt;
+        // Keep each bucket in table order so stores create their MDST entries
+        // in the same order as a walk over the whole table would
+        uint64_t bucket = mdptStoreBucket(mdpt.stpc);
+        int32_t prev = -1;
+        int32_t next = mdpt_st_head[bucket];
+        while (next >= 0 && next < i) {
+            prev = next;
+            next = mdpt_st_next[next];
+        }
+        mdpt_st_prev[i] = prev;
+        mdpt_st_next[i] = next;
+        if (prev >= 0)
+            mdpt_st_next[prev] = i;
+        else
+            mdpt_st_head[bucket] = i;
+        if (next >= 0)
+            mdpt_st_prev[next] = i;
+    }
+
+    uint64_t ibq_size;
+    uint64_t threshold;
+    uint64_t ways;
+    // The MDPT is indexed by a hash of the load PC. Set s occupies entries
+    // [s * ways, (s + 1) * ways).
+    MDPT_entry* MDPT;
+    uint64_t mdpt_sets;
+    uint64_t mdpt_entries;
+    // Secondary index of the MDPT by store PC: each bucket heads a doubly
+    // linked list of the valid entries whose store PC hashes to it
+    int32_t* mdpt_st_head;
+    int32_t* mdpt_st_next;
+    int32_t* mdpt_st_prev;
+    // MDST entries are chained per IBQ slot of the producing store. Unused
+    // entries are kept on a free list.
+    MDST_entry* MDST;
+    uint64_t mdst_size;
+    int32_t* mdst_head;
+    int32_t* mdst_tail;
+    int32_t mdst_free;
+};
+
+// Instructions between clears of the store set tables
+#define STORESET_CLEAR_INTERVAL 1000000
+
+// Store sets (Chrysos and Emer, ISCA 1998). The SSIT maps load and store PCs
+// to a store set ID, and the LFST holds the last fetched, unresolved store of
+// each set. A load in a set waits for that store. The SSIT is cleared
+// periodically so stale dependences do not accumulate. The LFST needs no
+// clearing: an entry is dropped when its store resolves or leaves the IBQ.
+// A wait counts as a false dependence only if no older unresolved store wrote
+// the load's address, whichever store of the set it waited on.
+// The SSIT has mdpt_size entries and there are mdst_size store sets.
+class StoreSetPredictor {
+public:
+    StoreSetPredictor(MDSimConfig& cfg) : ibq_size(cfg.ibq_size), waiting(cfg.ibq_size) {
+        ssit_size = cfg.mdpt_size;
+        sets = cfg.mdst_size > 0 ? cfg.mdst_size : 1;
+        ssit = (uint32_t*) calloc_lines(ssit_size, sizeof(uint32_t));
+        lfst = (int32_t*) malloc(sizeof(int32_t) * sets);
+        for (uint64_t i = 0; i < sets; i++)
+            lfst[i] = -1;
+        store_set = (uint32_t*) calloc_lines(cfg.ibq_size, sizeof(uint32_t));
+        next_set = 0;
+        next_clear = STORESET_CLEAR_INTERVAL;
+    }
+
+    ~StoreSetPredictor() {
+        free(store_set);
+        free(lfst);
+        free(ssit);
+    }
+
+    MDLoadDecision dispatchLoad(uint64_t slot, uint64_t ldpc, uint64_t now) {
+        if (now >= next_clear) {
+            memset(ssit, 0, sizeof(uint32_t) * ssit_size);
+            next_clear = now + STORESET_CLEAR_INTERVAL;
+        }
+        // SSIT entries hold the set ID plus one, so 0 means no set
+        uint32_t id = ssit[pc_hash(ldpc, ssit_size)];
+        if (id == 0 || lfst[id - 1] < 0)
+            return LOAD_FREE;
+        waiting.add(lfst[id - 1], slot);
+        return LOAD_WAIT;
+    }
+
+    void dispatchStore(uint64_t slot, uint64_t stpc) {
+        uint32_t id = ssit[pc_hash(stpc, ssit_size)];
+        store_set[slot] = id;
+        if (id)
+            lfst[id - 1] = slot;
+    }
+
+    template <class Sim>
+    void resolveStore(Sim& sim, uint64_t slot, uint64_t now) {
+        uint32_t id = store_set[slot];
+        if (id && lfst[id - 1] == (int32_t) slot)
+            lfst[id - 1] = -1;
+        waiting.resolve(sim, slot);
+    }
+
+    // Puts the load and the store in the same set
+    void violation(uint64_t ldpc, uint64_t stpc, uint64_t dist, uint64_t now) {
+        uint32_t& ld_id = ssit[pc_hash(ldpc, ssit_size)];
+        uint32_t& st_id = ssit[pc_hash(stpc, ssit_size)];
+        if (ld_id == 0 && st_id == 0) {
+            ld_id = next_set + 1;
+            st_id = next_set + 1;
+            next_set = (next_set + 1) % sets;
+        }
+        else if (ld_id == 0) {
+            ld_id = st_id;
+        }
+        else if (st_id == 0) {
+            st_id = ld_id;
+        }
+        else {
+            // Merge: both move to the smaller set
+            uint32_t id = ld_id < st_id ? ld_id : st_id;
+            ld_id = id;
+            st_id = id;
+        }
+    }
+
+    void warm(uint64_t ldpc, uint64_t stpc, uint64_t dist, uint64_t now) {
+        violation(ldpc, stpc, dist, now);
+    }
+
+    void retireSlot(uint64_t slot) {
+        uint32_t id = store_set[slot];
+        if (id && lfst[id - 1] == (int32_t) slot)
+            lfst[id - 1] = -1;
+        store_set[slot] = 0;
+        waiting.clear(slot);
+    }
+
+    void save(std::ostream& out) const {
+        ckpt_put(out, ssit, sizeof(uint32_t) * ssit_size);
+        ckpt_put(out, lfst, sizeof(int32_t) * sets);
+        ckpt_put(out, store_set, sizeof(uint32_t) * ibq_size);
+        ckpt_put(out, &next_set, sizeof(next_set));
+        ckpt_put(out, &next_clear, sizeof(next_clear));
+        waiting.save(out);
+    }
+
+    bool load(std::istream& in) {
+        return ckpt_get(in, ssit, sizeof(uint32_t) * ssit_size) &&
+               ckpt_get(in, lfst, sizeof(int32_t) * sets) &&
+               ckpt_get(in, store_set, sizeof(uint32_t) * ibq_size) &&
+               ckpt_get(in, &next_set, sizeof(next_set)) &&
+               ckpt_get(in, &next_clear, sizeof(next_clear)) &&
+               waiting.load(in);
+    }
+
+private:
+    StoreSetPredictor(const StoreSetPredictor&);
+    StoreSetPredictor& operator=(const StoreSetPredictor&);
+
+    uint32_t* ssit;
+    uint64_t ssit_size;
+    int32_t* lfst;          // IBQ slot of the last fetched store of each set
+    uint64_t sets;
+    uint64_t ibq_size;
+    uint32_t* store_set;    // Set of the store in each IBQ slot, plus one
+    uint32_t next_set;
+    uint64_t next_clear;
+    MDWaitLists waiting;
+};
+
+// Instructions between clears of the wait table (16K cycles on the 21264)
+#define WAITBIT_CLEAR_INTERVAL 16384
+
+// Wait table as in the Alpha 21264: one bit per load PC hash, set when the
+// load mis-speculates. A load with its bit set waits until every older store
+// has resolved, modelled as waiting on the youngest unresolved store. The
+// wait was needed if any of those stores wrote the load's address. The table
+// has mdpt_size entries and is cleared periodically.
+class WaitBitPredictor {
+public:
+    WaitBitPredictor(MDSimConfig& cfg) : waiting(cfg.ibq_size) {
+        bits_size = cfg.mdpt_size;
+        bits = (uint8_t*) calloc_lines(bits_size, sizeof(uint8_t));
+        youngest_store = -1;
+        next_clear = WAITBIT_CLEAR_INTERVAL;
+    }
+
+    ~WaitBitPredictor() {
+        free(bits);
+    }
+
+    MDLoadDecision dispatchLoad(uint64_t slot, uint64_t ldpc, uint64_t now) {
+        if (now >= next_clear) {
+            memset(bits, 0, bits_size);
+            next_clear = now + WAITBIT_CLEAR_INTERVAL;
+        }
+        if (!bits[pc_hash(ldpc, bits_size)] || youngest_store < 0)
+            return LOAD_FREE;
+        waiting.add(youngest_store, slot);
+        return LOAD_WAIT;
+    }
+
+    void dispatchStore(uint64_t slot, uint64_t stpc) {
+        youngest_store = slot;
+    }
+
+    template <class Sim>
+    void resolveStore(Sim& sim, uint64_t slot, uint64_t now) {
+        if (youngest_store == (int32_t) slot)
+            youngest_store = -1;
+        waiting.resolve(sim, slot);
+    }
+
+    void violation(uint64_t ldpc, uint64_t stpc, uint64_t dist, uint64_t now) {
+        bits[pc_hash(ldpc, bits_size)] = 1;
+    }
+
+    void warm(uint64_t ldpc, uint64_t stpc, uint64_t dist, uint64_t now) {
+        violation(ldpc, stpc, dist, now);
+    }
+
+    void retireSlot(uint64_t slot) {
+        if (youngest_store == (int32_t) slot)
+            youngest_store = -1;
+        waiting.clear(slot);
+    }
+
+    void save(std::ostream& out) const {
+        ckpt_put(out, bits, bits_size);
+        ckpt_put(out, &youngest_store, sizeof(youngest_store));
+        ckpt_put(out, &next_clear, sizeof(next_clear));
+        waiting.save(out);
+    }
+
+    bool load(std::istream& in) {
+        return ckpt_get(in, bits, bits_size) &&
+               ckpt_get(in, &youngest_store, sizeof(youngest_store)) &&
+               ckpt_get(in, &next_clear, sizeof(next_clear)) &&
+               waiting.load(in);
+    }
+
+private:
+    WaitBitPredictor(const WaitBitPredictor&);
+    WaitBitPredictor& operator=(const WaitBitPredictor&);
+
+    uint8_t* bits;
+    uint64_t bits_size;
+    int32_t youngest_store;
+    uint64_t next_clear;
+    MDWaitLists waiting;
+};
+
+#endif
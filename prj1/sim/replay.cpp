@@ -0,0 +1,437 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <thread>
+#include <unistd.h>
+
+#include "mdsim.h"
+#include "trace.h"
+#include "sample.h"
+#include "interval.h"
+#include "topk.h"
+#include "checkpoint.h"
+#include "live.h"
+
+using namespace std;
+
+// Replays a recorded instruction stream through the MDPT/MDST simulator.
+// The trace is either a binary trace written by the loadStore pintool's
+// -trace knob (see trace.h), or a text file with one instruction per line:
+//
+//     <pc hex> <L|S|-> <ea hex> [thread id]
+//
+// Each guest thread is simulated separately and the statistics are summed.
+
+static void usage(const char* prog) {
+    cerr << "usage: " << prog << " [-w window] [-p mdpt_size] [-a ways] [-o output] [-s config]... [-x skip -d detail -f ffwd [-n]] [-i interval [-I file]] [-k pairs] [-R|-W checkpoint] [-C checkpoint [-c n]] [-L file] [trace]" << endl;
+    cerr << "  -w  Store Resolution Window in cycles (default 30)" << endl;
+    cerr << "  -p  MDPT entries (default: IBQ size)" << endl;
+    cerr << "  -a  MDPT associativity, 0 for fully associative (default 4)" << endl;
+    cerr << "  -o  output file (default stdout)" << endl;
+    cerr << "  -s  add a simulator, e.g. w=20,mdpt=256,o=replay_20.out (see mdsim_parse_config)" << endl;
+    cerr << "      all simulators are fed from one pass over the trace" << endl;
+    cerr << "      pred=<name> picks the predictor:" << endl;
+    for (size_t i = 0; i < mdsim_predictor_count(); i++)
+        cerr << "        " << mdsim_predictor(i).name << ": " << mdsim_predictor(i).description << endl;
+    cerr << "  -x  sampling: instructions to skip at the start" << endl;
+    cerr << "  -d  sampling: instructions per detailed interval (default 0, no sampling)" << endl;
+    cerr << "  -f  sampling: instructions per fast-forward interval" << endl;
+    cerr << "  -n  sampling: do not train the MDPT while fast-forwarding" << endl;
+    cerr << "  -i  write the counters of every simulator every this many instructions" << endl;
+    cerr << "  -I  interval output, JSON lines if it ends in .json or .jsonl (default intervals.csv)" << endl;
+    cerr << "  -k  also report the load/store pairs with the most mis-speculations and false dependencies" << endl;
+    cerr << "  -R  resume from a checkpoint: restore the simulators and skip what they already ran" << endl;
+    cerr << "  -W  warm start from a checkpoint: restore the predictor tables only" << endl;
+    cerr << "  -C  write a checkpoint at the end, or after -c instructions of each thread" << endl;
+    cerr << "  -L  publish the counters of every simulator to this file while running (see livestats)" << endl;
+    cerr << "  trace defaults to stdin" << endl;
+}
+
+// Records per stepBatch call
+#define REPLAY_BATCH 4096
+
+// Interval snapshots buffered per simulator before they are written
+#define REPLAY_INTERVAL_RING 4096
+
+// Everything needed to set up the simulators of a new thread
+struct ReplaySetup {
+    vector<MDSimConfig> configs;
+    MDSampleConfig sample_cfg;
+    MDIntervalWriter* intervals;    // Interval statistics, if any
+    uint64_t every;
+    size_t topk;                    // Pairs to profile, if any
+    MDCheckpoint restore;
+    bool restoring;
+    bool warm_start;                // Only restore the predictor tables
+    MDCheckpoint checkpoint;
+    const char* checkpoint_name;    // Checkpoint output, if any
+    uint64_t checkpoint_at;         // 0 to checkpoint at the end
+    MDLiveStats* live;              // Live statistics, if any
+};
+
+// A pending checkpoint of one simulator, see MDSampler::markAt
+struct CheckpointMark {
+    ReplaySetup* setup;
+    uint32_t tid;
+    uint32_t sim;
+    MDSampler* sampler;
+    MDSim* s;
+};
+
+static void checkpoint_sim(void* arg) {
+    CheckpointMark* m = static_cast<CheckpointMark*>(arg);
+    m->setup->checkpoint.put(m->tid, m->sim, m->sampler->instructions(), *m->s);
+    if (!m->setup->checkpoint.write(m->setup->checkpoint_name))
+        cerr << "cannot write " << m->setup->checkpoint_name << endl;
+}
+
+// Simulator state of one guest thread, one simulator per configuration
+struct ThreadSims {
+    uint32_t tid;
+    vector<MDSim*> sims;
+    vector<MDSampler*> samplers;
+    vector<MDPairProfile*> profiles;    // Empty unless pairs are profiled
+    vector<CheckpointMark> marks;
+
+    ~ThreadSims() {
+        for (size_t s = 0; s < sims.size(); s++) {
+            delete samplers[s];
+            delete sims[s];
+        }
+        for (size_t s = 0; s < profiles.size(); s++)
+            delete profiles[s];
+    }
+};
+
+// Threads are keyed by id, which comes straight from the trace and need not
+// be small or dense
+typedef map<uint32_t, ThreadSims*> ThreadMap;
+
+static ThreadSims* thread_sims(ThreadMap& threads, uint32_t tid, ReplaySetup& setup) {
+    ThreadMap::iterator it = threads.find(tid);
+    if (it == threads.end()) {
+        ThreadSims* t = new ThreadSims();
+        t->tid = tid;
+        // The marks must not move once the samplers point at them
+        t->marks.resize(setup.configs.size());
+        for (size_t s = 0; s < setup.configs.size(); s++) {
+            MDSim* sim = mdsim_create(setup.configs[s]);
+            uint64_t done = 0;
+            if (setup.restoring) {
+                if (!setup.restore.get(tid, s, *sim, &done))
+                    cerr << "no matching checkpoint for thread " << tid << " simulator " << s << endl;
+                if (setup.warm_start) {
+                    sim->flush();
+                    sim->resetStats();
+                    done = 0;
+                }
+            }
+            if (setup.live)
+                sim->setLive(setup.live->addSlot(tid, s, setup.configs[s]));
+            t->sims.push_back(sim);
+            t->samplers.push_back(new MDSampler(sim, setup.sample_cfg));
+            t->samplers.back()->resume(done);
+            if (setup.intervals)
+                t->samplers.back()->logIntervals(setup.intervals->addRing(tid, s, REPLAY_INTERVAL_RING), setup.every);
+            if (setup.topk > 0) {
+                t->profiles.push_back(new MDPairProfile(mdpair_capacity(setup.topk)));
+                sim->setProfile(t->profiles.back());
+            }
+            if (setup.checkpoint_name && setup.checkpoint_at > 0) {
+                CheckpointMark& m = t->marks[s];
+                m.setup = &setup;
+                m.tid = tid;
+                m.sim = s;
+                m.sampler = t->samplers.back();
+                m.s = sim;
+                m.sampler->markAt(setup.checkpoint_at, checkpoint_sim, &m);
+            }
+        }
+        it = threads.insert(make_pair(tid, t)).first;
+    }
+    return it->second;
+}
+
+// Runs every simulator of thread tid through batch, then empties it
+static void replay_batch(ThreadMap& threads, uint32_t tid, ReplaySetup& setup, vector<MDSimRecord>& batch) {
+    ThreadSims* t = thread_sims(threads, tid, setup);
+    for (size_t s = 0; s < t->samplers.size(); s++)
+        t->samplers[s]->stepBatch(&batch[0], batch.size());
+    batch.clear();
+}
+
+int main(int argc, char** argv) {
+    uint64_t window = 30;
+    uint64_t mdpt_size = 0;
+    uint64_t ways = 4;
+    const char* out_name = NULL;
+    vector<string> specs;
+    MDSampleConfig sample_cfg;
+    memset(&sample_cfg, 0, sizeof(sample_cfg));
+    sample_cfg.warm = true;
+    uint64_t every = 0;
+    const char* interval_name = "intervals.csv";
+    size_t topk = 0;
+    const char* restore_name = NULL;
+    bool warm_start = false;
+    const char* checkpoint_name = NULL;
+    uint64_t checkpoint_at = 0;
+    const char* live_name = NULL;
+    int c;
+    while ((c = getopt(argc, argv, "w:p:a:o:s:x:d:f:ni:I:k:R:W:C:c:L:h")) != -1) {
+        switch (c) {
+            case 'w':
+                window = strtoull(optarg, NULL, 0);
+                break;
+            case 'p':
+                mdpt_size = strtoull(optarg, NULL, 0);
+                break;
+            case 'a':
+                ways = strtoull(optarg, NULL, 0);
+                break;
+            case 'o':
+                out_name = optarg;
+                break;
+            case 's':
+                specs.push_back(optarg);
+                break;
+            case 'x':
+                sample_cfg.skip = strtoull(optarg, NULL, 0);
+                break;
+            case 'd':
+                sample_cfg.detail = strtoull(optarg, NULL, 0);
+                break;
+            case 'f':
+                sample_cfg.ffwd = strtoull(optarg, NULL, 0);
+                break;
+            case 'n':
+                sample_cfg.warm = false;
+                break;
+            case 'i':
+                every = strtoull(optarg, NULL, 0);
+                break;
+            case 'I':
+                interval_name = optarg;
+                break;
+            case 'k':
+                topk = strtoul(optarg, NULL, 0);
+                break;
+            case 'R':
+            case 'W':
+                restore_name = optarg;
+                warm_start = c == 'W';
+                break;
+            case 'C':
+                checkpoint_name = optarg;
+                break;
+            case 'c':
+                checkpoint_at = strtoull(optarg, NULL, 0);
+                break;
+            case 'L':
+                live_name = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    MDSimConfig cfg = mdsim_default_config(window);
+    if (mdpt_size)
+        cfg.mdpt_size = mdpt_size;
+    cfg.mdpt_ways = ways;
+    vector<MDSimConfig> configs;
+    vector<string> out_names;
+    if (specs.empty()) {
+        configs.push_back(cfg);
+        out_names.push_back(out_name ? out_name : "");
+    }
+    for (size_t i = 0; i < specs.size(); i++) {
+        MDSimConfig sim_cfg = cfg;
+        string name;
+        if (!mdsim_parse_config(specs[i], sim_cfg, &name)) {
+            cerr << "bad simulator configuration " << specs[i] << endl;
+            return EXIT_FAILURE;
+        }
+        configs.push_back(sim_cfg);
+        out_names.push_back(name);
+    }
+    // Interval snapshots are written by a separate thread while simulating
+    ofstream interval_file;
+    MDIntervalWriter* intervals = NULL;
+    atomic<bool> intervals_done(false);
+    thread interval_thread;
+    if (every > 0) {
+        interval_file.open(interval_name);
+        if (!interval_file.is_open()) {
+            cerr << "cannot open " << interval_name << endl;
+            return EXIT_FAILURE;
+        }
+        intervals = new MDIntervalWriter(interval_file, mdinterval_jsonl(interval_name));
+        interval_thread = thread([&]() {
+            while (!intervals_done.load()) {
+                if (intervals->drain() == 0)
+                    usleep(1000);
+            }
+        });
+    }
+    auto finish_intervals = [&]() {
+        if (intervals == NULL)
+            return;
+        intervals_done.store(true);
+        interval_thread.join();
+        intervals->drain();
+        if (intervals->dropped() > 0)
+            cerr << intervals->dropped() << " interval snapshots were dropped" << endl;
+        delete intervals;
+        intervals = NULL;
+    };
+    ReplaySetup setup;
+    setup.configs = configs;
+    setup.sample_cfg = sample_cfg;
+    setup.intervals = intervals;
+    setup.every = every;
+    setup.topk = topk;
+    setup.restoring = restore_name != NULL;
+    setup.warm_start = warm_start;
+    setup.checkpoint_name = checkpoint_name;
+    setup.checkpoint_at = checkpoint_at;
+    MDLiveStats live;
+    setup.live = NULL;
+    if (live_name) {
+        if (!live.create(live_name, MDLIVE_SLOTS)) {
+            cerr << "cannot create " << live_name << endl;
+            finish_intervals();
+            return EXIT_FAILURE;
+        }
+        setup.live = &live;
+    }
+    if (restore_name && !setup.restore.read(restore_name)) {
+        cerr << "cannot read checkpoint " << restore_name << endl;
+        finish_intervals();
+        return EXIT_FAILURE;
+    }
+    // Every guest thread gets its own simulators, created on first use
+    ThreadMap threads;
+    if (optind < argc && trace_is_binary(argv[optind])) {
+        TraceReader reader;
+        if (!reader.open(argv[optind])) {
+            cerr << "cannot open " << argv[optind] << endl;
+            finish_intervals();
+            return EXIT_FAILURE;
+        }
+        // Records are decoded into batches of one thread, and every
+        // simulator of that thread runs through the whole batch in turn
+        vector<MDSimRecord> batch;
+        batch.reserve(REPLAY_BATCH);
+        TraceRecord r;
+        uint32_t tid = 0;
+        for (;;) {
+            bool more = reader.next(r);
+            if (!batch.empty() && (!more || r.tid != tid || batch.size() == REPLAY_BATCH))
+                replay_batch(threads, tid, setup, batch);
+            if (!more)
+                break;
+            tid = r.tid;
+            MDSimRecord rec;
+            rec.nonmem = r.nonmem;
+            rec.pc = r.pc;
+            rec.ea = r.ea;
+            rec.ld = r.ld;
+            rec.st = r.st;
+            batch.push_back(rec);
+        }
+    }
+    else {
+        FILE* in = stdin;
+        if (optind < argc) {
+            in = fopen(argv[optind], "r");
+            if (in == NULL) {
+                cerr << "cannot open " << argv[optind] << endl;
+                finish_intervals();
+                return EXIT_FAILURE;
+            }
+        }
+        // Lines are batched per thread as binary records are, with runs of
+        // non-memory instructions folded into one record
+        vector<MDSimRecord> batch;
+        batch.reserve(REPLAY_BATCH);
+        uint32_t cur_tid = 0;
+        char line[256];
+        while (fgets(line, sizeof(line), in)) {
+            unsigned long long pc, ea;
+            char kind;
+            unsigned tid = 0;
+            if (sscanf(line, "%llx %c %llx %u", &pc, &kind, &ea, &tid) < 3)
+                continue;
+            if (!batch.empty() && (tid != cur_tid || batch.size() == REPLAY_BATCH))
+                replay_batch(threads, cur_tid, setup, batch);
+            cur_tid = tid;
+            bool ld = kind == 'L', st = kind == 'S';
+            if (!ld && !st && !batch.empty() && !batch.back().ld && !batch.back().st) {
+                batch.back().nonmem++;
+                continue;
+            }
+            MDSimRecord rec;
+            rec.nonmem = ld || st ? 0 : 1;
+            rec.pc = pc;
+            rec.ea = ea;
+            rec.ld = ld;
+            rec.st = st;
+            batch.push_back(rec);
+        }
+        if (!batch.empty())
+            replay_batch(threads, cur_tid, setup, batch);
+        if (in != stdin)
+            fclose(in);
+    }
+    if (threads.empty())
+        thread_sims(threads, 0, setup);
+
+    // Checkpoint before reporting, which ends the sampling intervals
+    if (checkpoint_name && checkpoint_at == 0) {
+        for (ThreadMap::iterator it = threads.begin(); it != threads.end(); ++it)
+            for (size_t s = 0; s < configs.size(); s++)
+                setup.checkpoint.put(it->first, s, it->second->samplers[s]->instructions(), *it->second->sims[s]);
+        if (!setup.checkpoint.write(checkpoint_name))
+            cerr << "cannot write " << checkpoint_name << endl;
+    }
+
+    // Merge the threads into the one with the lowest id
+    ThreadMap::iterator it = threads.begin();
+    ThreadSims* first = it->second;
+    for (++it; it != threads.end(); ++it) {
+        for (size_t s = 0; s < configs.size(); s++)
+            first->samplers[s]->merge(*it->second->samplers[s]);
+        for (size_t s = 0; s < first->profiles.size(); s++)
+            first->profiles[s]->merge(*it->second->profiles[s]);
+    }
+    for (size_t s = 0; s < configs.size(); s++) {
+        if (!out_names[s].empty()) {
+            ofstream out(out_names[s].c_str());
+            out.setf(ios::showbase);
+            first->samplers[s]->report(out);
+            if (topk > 0)
+                mdpair_report(out, *first->profiles[s], topk);
+        }
+        else {
+            cout.setf(ios::showbase);
+            first->samplers[s]->report(cout);
+            if (topk > 0)
+                mdpair_report(cout, *first->profiles[s], topk);
+        }
+    }
+    // Reporting snapshotted the last intervals
+    finish_intervals();
+    if (setup.live)
+        setup.live->finish();
+    for (ThreadMap::iterator it = threads.begin(); it != threads.end(); ++it)
+        delete it->second;
+    return EXIT_SUCCESS;
+}
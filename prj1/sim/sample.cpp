@@ -0,0 +1,280 @@
+#include "sample.h"
+#include <math.h>
+#include <string.h>
+
+using std::endl;
+
+// Two-sided 95% normal quantile
+#define SAMPLE_Z 1.96
+
+MDSampler::MDSampler(MDSim* s, const MDSampleConfig& c)
+    : sim(s), cfg(c), total(0), threads(1), ring(NULL), every(0), next_snap(UINT64_MAX), last_snap(0),
+      mark_at(UINT64_MAX), mark_fn(NULL), mark_arg(NULL), next_event(UINT64_MAX) {
+    memset(&ended, 0, sizeof(ended));
+    memset(&last, 0, sizeof(last));
+    start();
+}
+
+void MDSampler::start() {
+    if (cfg.detail == 0) {
+        // Not sampling: everything is detailed
+        phase = DETAIL;
+        left = UINT64_MAX;
+    }
+    else if (cfg.skip > 0) {
+        phase = SKIP;
+        left = cfg.skip;
+    }
+    else {
+        phase = DETAIL;
+        left = cfg.detail;
+    }
+}
+
+void MDSampler::endInterval() {
+    if (sim->stats().cycles > 0)
+        samples.push_back(sim->stats());
+    if (ring)
+        mdsim_stats_add(ended, sim->stats());
+    sim->resetStats();
+}
+
+void MDSampler::logIntervals(MDIntervalRing* r, uint64_t n) {
+    ring = r;
+    every = n;
+    last_snap = total;
+    // Counters restored from a checkpoint are not part of any interval
+    last = sim->stats();
+    next_snap = n > 0 ? total + n : UINT64_MAX;
+    next_event = next_snap < mark_at ? next_snap : mark_at;
+}
+
+void MDSampler::markAt(uint64_t n, void (*fn)(void*), void* arg) {
+    mark_fn = fn;
+    mark_arg = arg;
+    if (n <= total) {
+        fn(arg);
+        return;
+    }
+    mark_at = n;
+    next_event = next_snap < mark_at ? next_snap : mark_at;
+}
+
+void MDSampler::resume(uint64_t n) {
+    if (sampling())
+        sim->resetStats();
+    if (n > 0) {
+        phase = RESUME;
+        left = n;
+    }
+}
+
+void MDSampler::event() {
+    if (total == next_snap)
+        snapshot();
+    if (total == mark_at) {
+        mark_at = UINT64_MAX;
+        mark_fn(mark_arg);
+    }
+    next_event = next_snap < mark_at ? next_snap : mark_at;
+}
+
+void MDSampler::snapshot() {
+    MDSimStats cur = ended;
+    mdsim_stats_add(cur, sim->stats());
+    MDSimStats interval = cur;
+    mdsim_stats_sub(interval, last);
+    ring->push(total, interval);
+    last = cur;
+    last_snap = total;
+    next_snap = total + every;
+}
+
+void MDSampler::endIntervals() {
+    if (ring && total > last_snap)
+        snapshot();
+    ring = NULL;
+    next_snap = UINT64_MAX;
+    next_event = mark_at;
+}
+
+void MDSampler::nextPhase() {
+    if (phase == RESUME) {
+        start();
+        return;
+    }
+    if (phase == DETAIL) {
+        endInterval();
+        sim->flush();
+    }
+    if (phase != DETAIL || cfg.ffwd == 0) {
+        phase = DETAIL;
+        left = cfg.detail;
+    }
+    else {
+        phase = FFWD;
+        left = cfg.ffwd;
+    }
+}
+
+void MDSampler::stepNonMem(uint64_t n) {
+    while (n > 0) {
+        if (left == 0)
+            nextPhase();
+        uint64_t k = n < left ? n : left;
+        if (k > next_event - total)
+            k = next_event - total;
+        if (phase == DETAIL)
+            sim->stepNonMem(k);
+        else if (phase == FFWD && cfg.warm)
+            sim->warmNonMem(k);
+        left -= k;
+        total += k;
+        n -= k;
+        if (total == next_event)
+            event();
+    }
+}
+
+void MDSampler::stepBatch(const MDSimRecord* recs, size_t n) {
+    if (!sampling() && phase == DETAIL && next_event == UINT64_MAX) {
+        total += sim->stepBatch(recs, n);
+        return;
+    }
+    size_t i = 0;
+    while (i < n) {
+        // Records that fit in the current phase and before the next event go
+        // to the simulator in one call
+        uint64_t room = left < next_event - total ? left : next_event - total;
+        size_t j = i;
+        uint64_t len = 0;
+        while (j < n) {
+            uint64_t r = recs[j].nonmem + (recs[j].ld || recs[j].st ? 1 : 0);
+            if (len + r > room)
+                break;
+            len += r;
+            j++;
+        }
+        if (j > i) {
+            if (phase == DETAIL)
+                sim->stepBatch(recs + i, j - i);
+            else if (phase == FFWD && cfg.warm)
+                sim->warmBatch(recs + i, j - i);
+            left -= len;
+            total += len;
+            if (total == next_event)
+                event();
+            i = j;
+            continue;
+        }
+        // The record crosses a phase boundary
+        stepNonMem(recs[i].nonmem);
+        if (recs[i].ld || recs[i].st)
+            step(recs[i].pc, recs[i].st, recs[i].ld, recs[i].ea);
+        i++;
+    }
+}
+
+// Ratio estimate of sum(y) / sum(x) over the samples, with the half-width of
+// its confidence interval
+struct Estimate {
+    double ratio;
+    double half;
+};
+
+static Estimate ratio_estimate(const std::vector<double>& y, const std::vector<double>& x) {
+    Estimate e;
+    double sy = 0, sx = 0;
+    size_t m = y.size();
+    for (size_t i = 0; i < m; i++) {
+        sy += y[i];
+        sx += x[i];
+    }
+    e.ratio = sy / sx;
+    e.half = NAN;
+    if (m < 2 || sx == 0)
+        return e;
+    double ss = 0;
+    for (size_t i = 0; i < m; i++) {
+        double d = y[i] - e.ratio * x[i];
+        ss += d * d;
+    }
+    double xbar = sx / m;
+    e.half = SAMPLE_Z * sqrt(ss / (m - 1) / m) / xbar;
+    return e;
+}
+
+void MDSampler::merge(MDSampler& other) {
+    endIntervals();
+    other.endIntervals();
+    if (other.phase == DETAIL)
+        other.endInterval();
+    samples.insert(samples.end(), other.samples.begin(), other.samples.end());
+    other.samples.clear();
+    total += other.total;
+    other.total = 0;
+    threads += other.threads;
+    other.threads = 0;
+}
+
+void MDSampler::report(std::ostream& out) {
+    endIntervals();
+    if (phase == DETAIL)
+        endInterval();
+    size_t m = samples.size();
+    std::vector<double> ins(m), ld(m), st(m), pred(m), mispred(m), spec(m), misspec(m), fdep(m), buf(m);
+    MDSimStats sum;
+    memset(&sum, 0, sizeof(sum));
+    for (size_t i = 0; i < m; i++) {
+        mdsim_stats_add(sum, samples[i]);
+        ins[i] = samples[i].cycles;
+        ld[i] = samples[i].ld_ins_count;
+        st[i] = samples[i].st_ins_count;
+        pred[i] = samples[i].predictions;
+        mispred[i] = samples[i].mispredictions;
+        spec[i] = samples[i].speculations;
+        misspec[i] = samples[i].mis_speculations;
+        fdep[i] = samples[i].false_deps;
+        buf[i] = samples[i].ldst_buffer_time;
+    }
+
+    // Scale the counters by instructions seen over instructions simulated
+    double scale = sum.cycles ? (double) total / (double) sum.cycles : 0;
+    MDSimStats est;
+    est.cycles = total;
+    est.ld_ins_count = llround(sum.ld_ins_count * scale);
+    est.st_ins_count = llround(sum.st_ins_count * scale);
+    est.predictions = llround(sum.predictions * scale);
+    est.mispredictions = llround(sum.mispredictions * scale);
+    est.speculations = llround(sum.speculations * scale);
+    est.mis_speculations = llround(sum.mis_speculations * scale);
+    est.false_deps = llround(sum.false_deps * scale);
+    est.ldst_buffer_time = llround(sum.ldst_buffer_time * scale);
+    if (!sampling())
+        est = sum;
+    mdsim_report(out, sim->config(), est);
+    if (threads > 1)
+        out << "Threads: " << threads << endl;
+    if (!sampling())
+        return;
+
+    out << "Sampled Intervals: " << m << endl;
+    out << "Simulated Instructions: " << sum.cycles << endl;
+    out << "95% Confidence Intervals (+/-):" << endl;
+    if (m < 2) {
+        out << "  not available with fewer than two intervals" << endl;
+        return;
+    }
+    double n = (double) total;
+    out << "  Total Loads: " << ratio_estimate(ld, ins).half * n << endl;
+    out << "  Total Stores: " << ratio_estimate(st, ins).half * n << endl;
+    out << "  Total MDPT Predictions: " << ratio_estimate(pred, ins).half * n << endl;
+    out << "  Total MDPT Mispredictions: " << ratio_estimate(mispred, ins).half * n << endl;
+    out << "  Misprediction Rate: " << ratio_estimate(mispred, pred).half << endl;
+    out << "  Total Load Speculations: " << ratio_estimate(spec, ins).half * n << endl;
+    out << "  Total Load Mis-speculations: " << ratio_estimate(misspec, ins).half * n << endl;
+    out << "  Mis-speculation Rate: " << ratio_estimate(misspec, spec).half << endl;
+    out << "  Total False Dependencies: " << ratio_estimate(fdep, ins).half * n << endl;
+    out << "  Mis-speculations due to False Dependencies: " << ratio_estimate(fdep, misspec).half << endl;
+    out << "  Avg. Time in LD/ST Buffer (Loads): " << ratio_estimate(buf, ld).half << endl;
+}
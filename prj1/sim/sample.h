@@ -0,0 +1,99 @@
+#ifndef _SAMPLE_H_
+#define _SAMPLE_H_
+
+#include <stdint.h>
+#include <ostream>
+#include <vector>
+#include "mdsim.h"
+#include "interval.h"
+
+// Sampled simulation. The first skip instructions are not simulated, then
+// detailed intervals alternate with fast-forward intervals. While
+// fast-forwarding the MDPT is either trained by functional warming or left
+// alone. The counters of the detailed intervals are extrapolated to the whole
+// run with ratio estimators.
+
+struct MDSampleConfig {
+    uint64_t skip;      // Instructions skipped at the start
+    uint64_t detail;    // Instructions per detailed interval, 0 to simulate everything
+    uint64_t ffwd;      // Instructions per fast-forward interval
+    bool warm;          // Train the MDPT while fast-forwarding
+};
+
+class MDSampler {
+public:
+    // The simulator is not owned
+    MDSampler(MDSim* sim, const MDSampleConfig& cfg);
+
+    void step(uint64_t ins_addr, bool ins_st, bool ins_ld, uint64_t ea) {
+        if (left == 0)
+            nextPhase();
+        left--;
+        total++;
+        if (phase == DETAIL)
+            sim->step(ins_addr, ins_st, ins_ld, ea);
+        else if (phase == FFWD && cfg.warm)
+            sim->warm(ins_addr, ins_st, ins_ld, ea);
+        if (total == next_event)
+            event();
+    }
+    void stepNonMem(uint64_t n);
+    // Simulates a batch of records, see MDSim::stepBatch
+    void stepBatch(const MDSimRecord* recs, size_t n);
+
+    bool sampling() const { return cfg.detail > 0; }
+    // Snapshots the counters into ring (not owned) every `every`
+    // instructions. The last, partial interval is snapshotted when the
+    // sampler is merged or reported, which also ends the logging.
+    void logIntervals(MDIntervalRing* ring, uint64_t every);
+    // Calls fn(arg) between two instructions once n instructions have been
+    // seen, e.g. to checkpoint the simulator
+    void markAt(uint64_t n, void (*fn)(void*), void* arg);
+    // Drops the first n instructions without simulating them, because a
+    // restored checkpoint already covers them; the sampling schedule starts
+    // after them. Must be called before the first instruction. Counters of a
+    // sampled run are not carried over.
+    void resume(uint64_t n);
+    uint64_t instructions() const { return total; }
+    // Moves the intervals of another sampler with the same configuration into
+    // this one, e.g. to combine the threads of a program
+    void merge(MDSampler& other);
+    // Ends the current interval and writes the extrapolated statistics in the
+    // mdsim_report format, followed by 95% confidence intervals
+    void report(std::ostream& out);
+
+private:
+    enum Phase { SKIP, DETAIL, FFWD, RESUME };
+
+    void start();
+    void nextPhase();
+    void endInterval();
+    void snapshot();
+    void endIntervals();
+    void event();
+
+    MDSim* sim;
+    MDSampleConfig cfg;
+    Phase phase;
+    uint64_t left;      // Instructions left in this phase
+    uint64_t total;     // Instructions seen, simulated or not
+    uint64_t threads;   // Samplers merged into this one, counting itself
+    // Counters of each detailed interval (one interval when not sampling)
+    std::vector<MDSimStats> samples;
+
+    // Interval statistics, see logIntervals
+    MDIntervalRing* ring;
+    uint64_t every;
+    uint64_t next_snap;     // Value of total at the next snapshot
+    uint64_t last_snap;     // Value of total at the last snapshot
+    MDSimStats ended;       // Counters of the sampling intervals already ended
+    MDSimStats last;        // Counters (including ended) at the last snapshot
+
+    // See markAt
+    uint64_t mark_at;
+    void (*mark_fn)(void*);
+    void* mark_arg;
+    uint64_t next_event;    // Smaller of next_snap and mark_at
+};
+
+#endif
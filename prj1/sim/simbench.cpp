@@ -0,0 +1,199 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <unistd.h>
+
+#include "mdsim.h"
+#include "trace.h"
+#include "synth.h"
+
+using namespace std;
+
+// Measures how fast the simulator core runs, by feeding synthetic streams
+// (see synth.h) to every configuration and timing only MDSim::stepBatch.
+// Writes one CSV row per stream and configuration with the best of -r runs.
+
+static void usage(const char* prog) {
+    cerr << "usage: " << prog << " [options]" << endl;
+    cerr << "  -s  add a simulator, e.g. w=20,pred=storeset (see mdsim_parse_config, default w=30)" << endl;
+    cerr << "  -g  comma separated streams (default all):";
+    for (int k = 0; k < SYNTH_KINDS; k++)
+        cerr << " " << synth_name((SynthKind) k);
+    cerr << endl;
+    cerr << "  -n  instructions per run (default 10000000)" << endl;
+    cerr << "  -r  runs per stream and simulator, the fastest is reported (default 3)" << endl;
+    cerr << "  -m  fraction of instructions that access memory (default 0.4)" << endl;
+    cerr << "  -S  fraction of memory instructions that are stores (default 0.33)" << endl;
+    cerr << "  -d  alias: instructions from a store to the load that reads it (default 8)" << endl;
+    cerr << "  -t  strided: stride in bytes (default 8)" << endl;
+    cerr << "  -f  bytes of data touched (default 1048576)" << endl;
+    cerr << "  -p  static memory instructions (default 64)" << endl;
+    cerr << "  -e  random seed (default 1)" << endl;
+    cerr << "  -T  write the first stream of -g to this binary trace instead" << endl;
+}
+
+// Records generated per stepBatch call
+#define SIMBENCH_BATCH 4096
+
+static bool parse_kinds(const char* arg, vector<SynthKind>& kinds) {
+    kinds.clear();
+    string s(arg);
+    size_t pos = 0;
+    while (pos <= s.size()) {
+        size_t comma = s.find(',', pos);
+        if (comma == string::npos)
+            comma = s.size();
+        int k = synth_find(s.substr(pos, comma - pos));
+        if (k < 0)
+            return false;
+        kinds.push_back((SynthKind) k);
+        pos = comma + 1;
+    }
+    return true;
+}
+
+// Runs one stream through a new simulator. Returns the seconds spent in the
+// simulator; the stream is generated outside the timed region.
+static double run(const SynthConfig& synth, const MDSimConfig& cfg, uint64_t n, MDSimStats& stats) {
+    using namespace std::chrono;
+    vector<MDSimRecord> recs(SIMBENCH_BATCH);
+    SynthStream stream(synth);
+    MDSim* sim = mdsim_create(cfg);
+    duration<double> busy(0);
+    uint64_t done = 0;
+    while (done < n) {
+        done += stream.fill(&recs[0], recs.size());
+        high_resolution_clock::time_point t0 = high_resolution_clock::now();
+        sim->stepBatch(&recs[0], recs.size());
+        busy += high_resolution_clock::now() - t0;
+    }
+    stats = sim->stats();
+    delete sim;
+    return busy.count();
+}
+
+static bool write_trace(const SynthConfig& synth, uint64_t n, const char* path) {
+    TraceWriter writer;
+    if (!writer.open(path))
+        return false;
+    vector<MDSimRecord> recs(SIMBENCH_BATCH);
+    SynthStream stream(synth);
+    uint64_t done = 0;
+    while (done < n) {
+        done += stream.fill(&recs[0], recs.size());
+        for (size_t i = 0; i < recs.size(); i++) {
+            writer.writeNonMem(0, recs[i].nonmem);
+            writer.write(recs[i].pc, recs[i].st, recs[i].ld, recs[i].ea);
+        }
+    }
+    writer.close();
+    return true;
+}
+
+int main(int argc, char** argv) {
+    vector<string> specs;
+    vector<SynthKind> kinds;
+    for (int k = 0; k < SYNTH_KINDS; k++)
+        kinds.push_back((SynthKind) k);
+    SynthConfig base = synth_default_config(SYNTH_STRIDED);
+    uint64_t n = 10000000;
+    uint64_t runs = 3;
+    const char* trace_name = NULL;
+    int c;
+    while ((c = getopt(argc, argv, "s:g:n:r:m:S:d:t:f:p:e:T:h")) != -1) {
+        switch (c) {
+            case 's':
+                specs.push_back(optarg);
+                break;
+            case 'g':
+                if (!parse_kinds(optarg, kinds)) {
+                    cerr << "bad stream list " << optarg << endl;
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'n':
+                n = strtoull(optarg, NULL, 0);
+                break;
+            case 'r':
+                runs = strtoull(optarg, NULL, 0);
+                break;
+            case 'm':
+                base.mem_ratio = strtod(optarg, NULL);
+                break;
+            case 'S':
+                base.store_ratio = strtod(optarg, NULL);
+                break;
+            case 'd':
+                base.distance = strtoull(optarg, NULL, 0);
+                break;
+            case 't':
+                base.stride = strtoull(optarg, NULL, 0);
+                break;
+            case 'f':
+                base.footprint = strtoull(optarg, NULL, 0);
+                break;
+            case 'p':
+                base.pcs = strtoull(optarg, NULL, 0);
+                break;
+            case 'e':
+                base.seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'T':
+                trace_name = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (optind != argc) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (runs == 0)
+        runs = 1;
+
+    if (trace_name) {
+        SynthConfig synth = base;
+        synth.kind = kinds[0];
+        if (!write_trace(synth, n, trace_name)) {
+            cerr << "cannot write " << trace_name << endl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    if (specs.empty())
+        specs.push_back("w=30");
+    vector<MDSimConfig> configs;
+    for (size_t i = 0; i < specs.size(); i++) {
+        MDSimConfig cfg = mdsim_default_config(30);
+        if (!mdsim_parse_config(specs[i], cfg, NULL)) {
+            cerr << "bad simulator configuration " << specs[i] << endl;
+            return EXIT_FAILURE;
+        }
+        configs.push_back(cfg);
+    }
+
+    cout << "stream,config,instructions,seconds,mips,mis_speculation_rate" << endl;
+    for (size_t k = 0; k < kinds.size(); k++) {
+        SynthConfig synth = base;
+        synth.kind = kinds[k];
+        for (size_t s = 0; s < configs.size(); s++) {
+            MDSimStats stats;
+            double best = 0;
+            for (uint64_t r = 0; r < runs; r++) {
+                double secs = run(synth, configs[s], n, stats);
+                if (r == 0 || secs < best)
+                    best = secs;
+            }
+            double rate = stats.speculations ? (double) stats.mis_speculations / stats.speculations : 0;
+            cout << synth_name(kinds[k]) << ",\"" << specs[s] << "\"," << stats.cycles << ","
+                 << best << "," << stats.cycles / best / 1e6 << "," << rate << endl;
+        }
+    }
+    return EXIT_SUCCESS;
+}
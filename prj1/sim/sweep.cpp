@@ -0,0 +1,204 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <unistd.h>
+
+#include "mdsim.h"
+#include "trace.h"
+#include "tracesim.h"
+#include "live.h"
+
+using namespace std;
+
+// Simulates a grid of configurations over one binary trace on a pool of
+// threads. The trace mapping is shared read-only; every worker decodes it
+// with its own cursor into its own simulator. Results are written as CSV in
+// grid order.
+
+static void usage(const char* prog) {
+    cerr << "usage: " << prog << " [options] <binary trace>" << endl;
+    cerr << "  Each option takes a comma separated list of values, and every" << endl;
+    cerr << "  combination is simulated. A size of 0 is derived from the window." << endl;
+    cerr << "  -w  Store Resolution Windows (default 10,20,30)" << endl;
+    cerr << "  -i  IBQ sizes (default 0)" << endl;
+    cerr << "  -p  MDPT sizes (default 0)" << endl;
+    cerr << "  -a  MDPT associativities, 0 for fully associative (default 4)" << endl;
+    cerr << "  -m  MDST sizes (default 0)" << endl;
+    cerr << "  -t  predictor thresholds (default 2)" << endl;
+    cerr << "  -P  predictors by name (default mdpt), one of:" << endl;
+    for (size_t i = 0; i < mdsim_predictor_count(); i++)
+        cerr << "        " << mdsim_predictor(i).name << ": " << mdsim_predictor(i).description << endl;
+    cerr << "  -j  worker threads (default: number of cores)" << endl;
+    cerr << "  -o  CSV output file (default stdout)" << endl;
+    cerr << "  -L  publish the counters of every configuration to this file while running (see livestats)" << endl;
+}
+
+static bool parse_list(const char* arg, vector<uint64_t>& list) {
+    list.clear();
+    string s(arg);
+    size_t pos = 0;
+    while (pos <= s.size()) {
+        size_t comma = s.find(',', pos);
+        if (comma == string::npos)
+            comma = s.size();
+        string item = s.substr(pos, comma - pos);
+        char* end;
+        uint64_t v = strtoull(item.c_str(), &end, 0);
+        if (item.empty() || *end != '\0')
+            return false;
+        list.push_back(v);
+        pos = comma + 1;
+    }
+    return true;
+}
+
+static bool parse_predictors(const char* arg, vector<uint64_t>& list) {
+    list.clear();
+    string s(arg);
+    size_t pos = 0;
+    while (pos <= s.size()) {
+        size_t comma = s.find(',', pos);
+        if (comma == string::npos)
+            comma = s.size();
+        int p = mdsim_find_predictor(s.substr(pos, comma - pos));
+        if (p < 0)
+            return false;
+        list.push_back(p);
+        pos = comma + 1;
+    }
+    return true;
+}
+
+static void worker(const TraceReader* reader, vector<MDSimConfig>* grid,
+                   vector<MDSimStats>* results, atomic<size_t>* next, MDLiveStats* live) {
+    for (;;) {
+        size_t i = next->fetch_add(1);
+        if (i >= grid->size())
+            return;
+        TraceSims sims((*grid)[i], live, i);
+        TracePos pos = tracesim_begin(*reader);
+        tracesim_run(*reader, pos, UINT64_MAX, &sims);
+        (*results)[i] = sims.stats();
+        // Record the configuration as the simulator resolved it
+        (*grid)[i] = sims.config();
+    }
+}
+
+int main(int argc, char** argv) {
+    vector<uint64_t> windows(1, 10), ibqs(1, 0), mdpts(1, 0), ways(1, 4), mdsts(1, 0), thresholds(1, 2), preds(1, 0);
+    windows.push_back(20);
+    windows.push_back(30);
+    unsigned threads = thread::hardware_concurrency();
+    const char* out_name = NULL;
+    const char* live_name = NULL;
+    int c;
+    bool ok = true;
+    while ((c = getopt(argc, argv, "w:i:p:a:m:t:P:j:o:L:h")) != -1) {
+        switch (c) {
+            case 'w':
+                ok = parse_list(optarg, windows);
+                break;
+            case 'i':
+                ok = parse_list(optarg, ibqs);
+                break;
+            case 'p':
+                ok = parse_list(optarg, mdpts);
+                break;
+            case 'a':
+                ok = parse_list(optarg, ways);
+                break;
+            case 'm':
+                ok = parse_list(optarg, mdsts);
+                break;
+            case 't':
+                ok = parse_list(optarg, thresholds);
+                break;
+            case 'P':
+                ok = parse_predictors(optarg, preds);
+                break;
+            case 'j':
+                threads = strtoul(optarg, NULL, 0);
+                break;
+            case 'o':
+                out_name = optarg;
+                break;
+            case 'L':
+                live_name = optarg;
+                break;
+            default:
+                ok = false;
+                break;
+        }
+        if (!ok)
+            break;
+    }
+    if (!ok || optind != argc - 1) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (threads == 0)
+        threads = 1;
+
+    TraceReader reader;
+    if (!reader.open(argv[optind])) {
+        cerr << argv[optind] << " is not a binary trace" << endl;
+        return EXIT_FAILURE;
+    }
+
+    // Expand the grid
+    vector<MDSimConfig> grid;
+    for (size_t w = 0; w < windows.size(); w++)
+    for (size_t i = 0; i < ibqs.size(); i++)
+    for (size_t p = 0; p < mdpts.size(); p++)
+    for (size_t a = 0; a < ways.size(); a++)
+    for (size_t m = 0; m < mdsts.size(); m++)
+    for (size_t t = 0; t < thresholds.size(); t++)
+    for (size_t r = 0; r < preds.size(); r++) {
+        MDSimConfig cfg = mdsim_default_config(windows[w]);
+        if (ibqs[i])
+            cfg.ibq_size = ibqs[i];
+        if (mdpts[p])
+            cfg.mdpt_size = mdpts[p];
+        cfg.mdpt_ways = ways[a];
+        if (mdsts[m])
+            cfg.mdst_size = mdsts[m];
+        cfg.pred_threshold = thresholds[t];
+        cfg.predictor = preds[r];
+        if (cfg.ibq_size <= cfg.store_resolve_cycles) {
+            cerr << "skipping window " << cfg.store_resolve_cycles << " with IBQ size " << cfg.ibq_size << endl;
+            continue;
+        }
+        grid.push_back(cfg);
+    }
+
+    // One live slot per configuration and guest thread, claimed when it starts
+    MDLiveStats live;
+    if (live_name && !live.create(live_name, MDLIVE_SLOTS)) {
+        cerr << "cannot create " << live_name << endl;
+        return EXIT_FAILURE;
+    }
+
+    vector<MDSimStats> results(grid.size());
+    atomic<size_t> next(0);
+    vector<thread> pool;
+    for (unsigned t = 0; t < threads && t < grid.size(); t++)
+        pool.push_back(thread(worker, &reader, &grid, &results, &next, live_name ? &live : NULL));
+    for (size_t t = 0; t < pool.size(); t++)
+        pool[t].join();
+    if (live_name)
+        live.finish();
+
+    ofstream file;
+    if (out_name)
+        file.open(out_name);
+    ostream& out = out_name ? file : cout;
+    mdsim_csv_header(out);
+    for (size_t i = 0; i < grid.size(); i++)
+        mdsim_csv_row(out, grid[i], results[i]);
+    return EXIT_SUCCESS;
+}
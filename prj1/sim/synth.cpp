@@ -0,0 +1,158 @@
+#include "synth.h"
+
+// Code and data are placed where a small program's would be
+#define SYNTH_CODE 0x400000ULL
+#define SYNTH_DATA 0x10000000ULL
+// chase: bytes per list node, and the most hops a store is ahead of the chase
+#define SYNTH_NODE 64
+#define SYNTH_AHEAD 4
+
+static const char* const synth_names[SYNTH_KINDS] = { "strided", "alias", "chase", "random" };
+
+SynthConfig synth_default_config(SynthKind kind) {
+    SynthConfig cfg;
+    cfg.kind = kind;
+    cfg.mem_ratio = 0.4;
+    cfg.store_ratio = 1.0 / 3;
+    cfg.stride = 8;
+    cfg.distance = 8;
+    cfg.footprint = 1 << 20;
+    cfg.pcs = 64;
+    cfg.seed = 1;
+    return cfg;
+}
+
+const char* synth_name(SynthKind kind) {
+    return synth_names[kind];
+}
+
+int synth_find(const std::string& name) {
+    for (int k = 0; k < SYNTH_KINDS; k++)
+        if (name == synth_names[k])
+            return k;
+    return -1;
+}
+
+SynthStream::SynthStream(const SynthConfig& c) : cfg(c), iter(0), now(0), node(0) {
+    state = cfg.seed * 0x9E3779B97F4A7C15ULL + 1;
+    if (cfg.pcs < 2)
+        cfg.pcs = 2;
+    if (cfg.footprint < 2 * SYNTH_NODE)
+        cfg.footprint = 2 * SYNTH_NODE;
+    if (cfg.mem_ratio <= 0 || cfg.mem_ratio > 1)
+        cfg.mem_ratio = 1;
+    mean_gap = (uint64_t) (2 * (1 - cfg.mem_ratio) / cfg.mem_ratio + 0.5);
+    if (cfg.kind == SYNTH_CHASE) {
+        // Sattolo's algorithm gives a single cycle through all nodes
+        uint64_t nodes = cfg.footprint / SYNTH_NODE;
+        chain.resize(nodes);
+        for (uint64_t i = 0; i < nodes; i++)
+            chain[i] = i;
+        for (uint64_t i = nodes - 1; i > 0; i--) {
+            uint64_t j = random() % i;
+            uint32_t t = chain[i];
+            chain[i] = chain[j];
+            chain[j] = t;
+        }
+    }
+}
+
+uint64_t SynthStream::random() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1DULL;
+}
+
+// Non-memory instructions before the next memory instruction
+uint64_t SynthStream::gap() {
+    return mean_gap > 0 ? random() % (mean_gap + 1) : 0;
+}
+
+// Static memory instructions below this index are stores
+static uint64_t store_pcs(const SynthConfig& cfg) {
+    uint64_t n = (uint64_t) (cfg.pcs * cfg.store_ratio + 0.5);
+    return n < cfg.pcs ? n : cfg.pcs - 1;
+}
+
+void SynthStream::next(MDSimRecord& r) {
+    r.nonmem = gap();
+    switch (cfg.kind) {
+        case SYNTH_STRIDED: {
+            // One pass of the loop body per element
+            uint64_t p = iter % cfg.pcs;
+            uint64_t elem = iter / cfg.pcs;
+            uint64_t half = cfg.footprint / 2;
+            r.st = p < store_pcs(cfg);
+            r.ld = !r.st;
+            r.pc = SYNTH_CODE + 4 * p;
+            r.ea = SYNTH_DATA + (r.st ? half : 0) + (elem * cfg.stride + 8 * p) % half;
+            iter++;
+            break;
+        }
+        case SYNTH_ALIAS: {
+            if (!pending.empty() && pending.front().due <= now + r.nonmem) {
+                // The oldest store is due to be read back
+                const PendingLoad& l = pending.front();
+                r.nonmem = l.due > now ? l.due - now : 0;
+                r.pc = l.pc;
+                r.ea = l.ea;
+                r.ld = true;
+                r.st = false;
+                now += r.nonmem + 1;
+                pending.pop_front();
+                break;
+            }
+            uint64_t p = random() % (cfg.pcs / 2);
+            r.pc = SYNTH_CODE + 4 * p;
+            r.ea = SYNTH_DATA + (random() % (cfg.footprint / 8)) * 8;
+            r.ld = false;
+            r.st = true;
+            now += r.nonmem;
+            PendingLoad l;
+            l.due = now + cfg.distance;
+            l.pc = SYNTH_CODE + 4 * (cfg.pcs / 2 + p);
+            l.ea = r.ea;
+            pending.push_back(l);
+            now++;
+            break;
+        }
+        case SYNTH_CHASE: {
+            if (random() % 1000 < cfg.store_ratio * 1000) {
+                // Update a node the chase is about to visit
+                uint32_t target = node;
+                uint64_t hops = 1 + random() % SYNTH_AHEAD;
+                for (uint64_t h = 0; h < hops; h++)
+                    target = chain[target];
+                r.pc = SYNTH_CODE + 4 * (cfg.pcs / 2 + random() % (cfg.pcs / 2));
+                r.ea = SYNTH_DATA + (uint64_t) target * SYNTH_NODE;
+                r.ld = false;
+                r.st = true;
+                break;
+            }
+            r.pc = SYNTH_CODE + 4 * (node % (cfg.pcs / 2));
+            r.ea = SYNTH_DATA + (uint64_t) node * SYNTH_NODE;
+            r.ld = true;
+            r.st = false;
+            node = chain[node];
+            break;
+        }
+        default: {
+            uint64_t p = random() % cfg.pcs;
+            r.pc = SYNTH_CODE + 4 * p;
+            r.ea = SYNTH_DATA + (random() % (cfg.footprint / 8)) * 8;
+            r.st = p < store_pcs(cfg);
+            r.ld = !r.st;
+            break;
+        }
+    }
+}
+
+uint64_t SynthStream::fill(MDSimRecord* recs, size_t n) {
+    uint64_t count = 0;
+    for (size_t i = 0; i < n; i++) {
+        next(recs[i]);
+        count += recs[i].nonmem + 1;
+    }
+    return count;
+}
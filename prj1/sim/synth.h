@@ -0,0 +1,78 @@
+#ifndef _SYNTH_H_
+#define _SYNTH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <deque>
+#include <string>
+#include <vector>
+#include "mdsim.h"
+
+// Synthetic instruction streams, to measure the simulator core without Pin or
+// a recorded trace. Every stream is deterministic for a given seed.
+//
+//     strided  a copy loop: stores walk one array and loads another with a
+//              fixed stride, so loads never depend on in-flight stores
+//     alias    every store is read back by a load exactly `distance`
+//              instructions later, from a fixed load PC per store PC
+//     chase    pointer chasing through a random cyclic list, with stores to
+//              nodes a few hops ahead of the chase
+//     random   loads and stores to random addresses from random PCs
+
+enum SynthKind {
+    SYNTH_STRIDED,
+    SYNTH_ALIAS,
+    SYNTH_CHASE,
+    SYNTH_RANDOM,
+    SYNTH_KINDS
+};
+
+struct SynthConfig {
+    SynthKind kind;
+    double mem_ratio;       // Fraction of instructions that access memory
+    double store_ratio;     // Fraction of memory instructions that are stores
+    uint64_t stride;        // strided: bytes between accesses
+    uint64_t distance;      // alias: instructions from a store to its load
+    uint64_t footprint;     // Bytes of data touched
+    uint64_t pcs;           // Static memory instructions
+    uint64_t seed;
+};
+
+// Defaults: 40% memory instructions, a third of them stores, 8 byte stride,
+// alias distance 8, 1MB footprint and 64 static memory instructions
+SynthConfig synth_default_config(SynthKind kind);
+const char* synth_name(SynthKind kind);
+// Returns the kind with this name, or -1
+int synth_find(const std::string& name);
+
+class SynthStream {
+public:
+    SynthStream(const SynthConfig& cfg);
+
+    // Writes the next n records (see MDSimRecord) and returns the number of
+    // instructions they hold
+    uint64_t fill(MDSimRecord* recs, size_t n);
+
+private:
+    uint64_t random();
+    uint64_t gap();
+    void next(MDSimRecord& r);
+
+    SynthConfig cfg;
+    uint64_t state;         // xorshift64* state
+    uint64_t mean_gap;      // Mean non-memory run, times two
+    uint64_t iter;          // strided: position in the loop
+    uint64_t now;           // alias: instructions generated so far
+    // alias: loads waiting to read back a store, oldest first
+    struct PendingLoad {
+        uint64_t due;
+        uint64_t pc;
+        uint64_t ea;
+    };
+    std::deque<PendingLoad> pending;
+    // chase: next node of each node, and the node being visited
+    std::vector<uint32_t> chain;
+    uint32_t node;
+};
+
+#endif
@@ -0,0 +1,165 @@
+#include "topk.h"
+#include <stdlib.h>
+#include <algorithm>
+
+using std::endl;
+
+MDPairCounter::MDPairCounter(size_t c) : size(0), capacity(c > 0 ? c : 1), total(0) {
+    heap = (Entry*) malloc(sizeof(Entry) * capacity);
+    // At least twice as many slots as counters keeps the probes short
+    uint64_t n = 4;
+    shift = 62;
+    while (n < 2 * capacity) {
+        n <<= 1;
+        shift--;
+    }
+    mask = n - 1;
+    slots = (int32_t*) malloc(sizeof(int32_t) * n);
+    for (uint64_t i = 0; i < n; i++)
+        slots[i] = -1;
+}
+
+MDPairCounter::~MDPairCounter() {
+    free(slots);
+    free(heap);
+}
+
+uint64_t MDPairCounter::home(uint64_t ldpc, uint64_t stpc) const {
+    return ((ldpc * 0x9E3779B97F4A7C15ULL) ^ (stpc * 0xC2B2AE3D27D4EB4FULL)) >> shift;
+}
+
+// Slot of the pair, or the empty slot where it would go
+uint64_t MDPairCounter::find(uint64_t ldpc, uint64_t stpc) const {
+    uint64_t i = home(ldpc, stpc);
+    while (slots[i] >= 0) {
+        const Entry& e = heap[slots[i]];
+        if (e.ldpc == ldpc && e.stpc == stpc)
+            break;
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+// Empties a slot, moving later entries of the probe sequence back into it
+void MDPairCounter::erase(uint64_t i) {
+    uint64_t j = i;
+    for (;;) {
+        j = (j + 1) & mask;
+        if (slots[j] < 0)
+            break;
+        const Entry& e = heap[slots[j]];
+        uint64_t k = home(e.ldpc, e.stpc);
+        // The entry stays if its home is cyclically in (i, j]
+        bool stays = i <= j ? (i < k && k <= j) : (i < k || k <= j);
+        if (stays)
+            continue;
+        slots[i] = slots[j];
+        heap[slots[i]].slot = i;
+        i = j;
+    }
+    slots[i] = -1;
+}
+
+void MDPairCounter::swap(size_t a, size_t b) {
+    Entry t = heap[a];
+    heap[a] = heap[b];
+    heap[b] = t;
+    slots[heap[a].slot] = a;
+    slots[heap[b].slot] = b;
+}
+
+void MDPairCounter::siftDown(size_t p) {
+    for (;;) {
+        size_t c = 2 * p + 1;
+        if (c >= size)
+            return;
+        if (c + 1 < size && heap[c + 1].count < heap[c].count)
+            c++;
+        if (heap[p].count <= heap[c].count)
+            return;
+        swap(p, c);
+        p = c;
+    }
+}
+
+void MDPairCounter::siftUp(size_t p) {
+    while (p > 0) {
+        size_t parent = (p - 1) / 2;
+        if (heap[parent].count <= heap[p].count)
+            return;
+        swap(p, parent);
+        p = parent;
+    }
+}
+
+void MDPairCounter::add(uint64_t ldpc, uint64_t stpc, uint64_t n, uint64_t err) {
+    total += n;
+    uint64_t i = find(ldpc, stpc);
+    if (slots[i] >= 0) {
+        Entry& e = heap[slots[i]];
+        e.count += n;
+        e.error += err;
+        siftDown(slots[i]);
+        return;
+    }
+    Entry e;
+    e.ldpc = ldpc;
+    e.stpc = stpc;
+    e.count = n;
+    e.error = err;
+    size_t p;
+    if (size < capacity) {
+        p = size++;
+    }
+    else {
+        // Take over the smallest counter
+        p = 0;
+        e.count += heap[0].count;
+        e.error += heap[0].count;
+        erase(heap[0].slot);
+        i = find(ldpc, stpc);
+    }
+    e.slot = i;
+    heap[p] = e;
+    slots[i] = p;
+    siftUp(p);
+    siftDown(p);
+}
+
+void MDPairCounter::merge(const MDPairCounter& other) {
+    for (size_t i = 0; i < other.size; i++)
+        add(other.heap[i].ldpc, other.heap[i].stpc, other.heap[i].count, other.heap[i].error);
+}
+
+static bool larger(const MDPairCounter::Entry& a, const MDPairCounter::Entry& b) {
+    return a.count > b.count;
+}
+
+std::vector<MDPairCounter::Entry> MDPairCounter::top(size_t k) const {
+    std::vector<Entry> v(heap, heap + size);
+    std::sort(v.begin(), v.end(), larger);
+    if (v.size() > k)
+        v.resize(k);
+    return v;
+}
+
+static void report_counter(std::ostream& out, const char* title, const MDPairCounter& c, size_t k) {
+    out << title << " (" << c.events() << " total):" << endl;
+    std::vector<MDPairCounter::Entry> top = c.top(k);
+    std::ios::fmtflags flags = out.flags();
+    for (size_t i = 0; i < top.size(); i++) {
+        const MDPairCounter::Entry& e = top[i];
+        out << "  " << i + 1 << ". Load " << std::hex << std::showbase << e.ldpc
+            << " Store " << e.stpc << std::dec << ": " << e.count
+            << " (" << 100.0 * e.count / c.events() << "%)";
+        if (e.error > 0)
+            out << ", overestimated by at most " << e.error;
+        out << endl;
+    }
+    out.flags(flags);
+}
+
+void mdpair_report(std::ostream& out, const MDPairProfile& profile, size_t k) {
+    report_counter(out, "Top Mis-speculating Load/Store Pairs", profile.mis_speculations, k);
+    report_counter(out, "Top False Dependency Load/Store Pairs", profile.false_deps, k);
+}
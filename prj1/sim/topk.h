@@ -0,0 +1,85 @@
+#ifndef _TOPK_H_
+#define _TOPK_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <ostream>
+#include <vector>
+
+// Heavy hitters over (load PC, store PC) pairs with the space-saving
+// algorithm (Metwally et al.). A fixed number of counters is kept in a
+// min-heap indexed by a hash table. A pair that is not tracked takes over the
+// smallest counter and inherits its count as its error. Every pair seen more
+// than events / capacity times is tracked, and no count is too high by more
+// than its error.
+class MDPairCounter {
+public:
+    struct Entry {
+        uint64_t ldpc;
+        uint64_t stpc;
+        uint64_t count;
+        uint64_t error;     // Upper bound of the overestimate in count
+        uint32_t slot;      // Hash table slot pointing at this entry
+    };
+
+    MDPairCounter(size_t capacity);
+    ~MDPairCounter();
+
+    // Counts n events of a pair, with err of them possibly not its own
+    void add(uint64_t ldpc, uint64_t stpc, uint64_t n = 1, uint64_t err = 0);
+    // Adds the counters of another tracker, e.g. of another thread
+    void merge(const MDPairCounter& other);
+    uint64_t events() const { return total; }
+    // The k largest counters, largest first
+    std::vector<Entry> top(size_t k) const;
+
+private:
+    MDPairCounter(const MDPairCounter&);
+    MDPairCounter& operator=(const MDPairCounter&);
+
+    uint64_t home(uint64_t ldpc, uint64_t stpc) const;
+    uint64_t find(uint64_t ldpc, uint64_t stpc) const;
+    void erase(uint64_t slot);
+    void swap(size_t a, size_t b);
+    void siftDown(size_t p);
+    void siftUp(size_t p);
+
+    Entry* heap;
+    size_t size;
+    size_t capacity;
+    int32_t* slots;     // Heap position of each hash table slot, -1 if empty
+    uint64_t mask;
+    uint64_t shift;
+    uint64_t total;
+};
+
+// Counters kept per pair that is reported, and at least
+#define MDPAIR_COUNTERS_PER_PAIR 8
+#define MDPAIR_MIN_COUNTERS 8192
+
+// Counters per event kind to report the top k pairs. A sketch with few
+// counters overcounts by about the number of events over its size.
+inline size_t mdpair_capacity(size_t k) {
+    size_t n = k * MDPAIR_COUNTERS_PER_PAIR;
+    return n > MDPAIR_MIN_COUNTERS ? n : MDPAIR_MIN_COUNTERS;
+}
+
+// The pairs behind the mis-speculations and false dependencies of one
+// simulator (see MDSim::setProfile)
+struct MDPairProfile {
+    MDPairCounter mis_speculations;
+    MDPairCounter false_deps;
+
+    // capacity counters per event kind
+    MDPairProfile(size_t capacity) : mis_speculations(capacity), false_deps(capacity) {}
+    void merge(const MDPairProfile& other) {
+        mis_speculations.merge(other.mis_speculations);
+        false_deps.merge(other.false_deps);
+    }
+};
+
+// Writes the k pairs with the most mis-speculations and false dependencies,
+// with their share of all such events
+void mdpair_report(std::ostream& out, const MDPairProfile& profile, size_t k);
+
+#endif
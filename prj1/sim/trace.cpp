@@ -0,0 +1,247 @@
+#include "trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define TRACE_BUF_SIZE (1 << 16)
+// Tag byte plus three 10-byte varints
+#define TRACE_MAX_RECORD 31
+#define TRACE_GAP_ESCAPE 63
+// Control records (kind 0)
+#define TRACE_CTL_RUN 0
+#define TRACE_CTL_THREAD 1
+
+static inline uint64_t zigzag(uint64_t delta) {
+    return (delta << 1) ^ (uint64_t)((int64_t)delta >> 63);
+}
+
+static inline uint64_t unzigzag(uint64_t v) {
+    return (v >> 1) ^ (0 - (v & 1));
+}
+
+TraceWriter::TraceWriter() : file(NULL), buf(NULL), buf_len(0), bytes(0), cur_tid(0), last_pc(0), last_ea(0) {
+    memset(&hdr, 0, sizeof(hdr));
+}
+
+TraceWriter::~TraceWriter() {
+    close();
+}
+
+bool TraceWriter::open(const char* path) {
+    file = fopen(path, "wb");
+    if (file == NULL)
+        return false;
+    memcpy(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic));
+    hdr.version = TRACE_VERSION;
+    hdr.instructions = 0;
+    hdr.mem_ops = 0;
+    buf = (uint8_t*) malloc(TRACE_BUF_SIZE);
+    buf_len = 0;
+    gaps.assign(1, 0);
+    cur_tid = 0;
+    last_pc = 0;
+    last_ea = 0;
+    fwrite(&hdr, sizeof(hdr), 1, file);
+    bytes = sizeof(hdr);
+    return true;
+}
+
+void TraceWriter::flush() {
+    fwrite(buf, 1, buf_len, file);
+    bytes += buf_len;
+    buf_len = 0;
+}
+
+void TraceWriter::putVarint(uint64_t v) {
+    while (v >= 0x80) {
+        buf[buf_len++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    buf[buf_len++] = (uint8_t)v;
+}
+
+void TraceWriter::switchThread(uint32_t tid) {
+    if (buf_len + TRACE_MAX_RECORD > TRACE_BUF_SIZE)
+        flush();
+    buf[buf_len++] = TRACE_CTL_THREAD << 2;
+    putVarint(tid);
+    cur_tid = tid;
+}
+
+void TraceWriter::writeNonMem(uint32_t tid, uint64_t n) {
+    hdr.instructions += n;
+    if (tid >= gaps.size())
+        gaps.resize(tid + 1, 0);
+    gaps[tid] += n;
+}
+
+void TraceWriter::write(uint32_t tid, uint64_t pc, bool st, bool ld, uint64_t ea) {
+    hdr.instructions++;
+    if (tid >= gaps.size())
+        gaps.resize(tid + 1, 0);
+    uint64_t& gap = gaps[tid];
+    if (!st && !ld) {
+        // Non-memory instructions are folded into the thread's next record
+        gap++;
+        return;
+    }
+    hdr.mem_ops++;
+    if (tid != cur_tid)
+        switchThread(tid);
+    if (buf_len + TRACE_MAX_RECORD > TRACE_BUF_SIZE)
+        flush();
+    uint8_t kind = (ld ? 1 : 0) | (st ? 2 : 0);
+    if (gap < TRACE_GAP_ESCAPE) {
+        buf[buf_len++] = kind | (uint8_t)(gap << 2);
+    }
+    else {
+        buf[buf_len++] = kind | (TRACE_GAP_ESCAPE << 2);
+        putVarint(gap);
+    }
+    putVarint(zigzag(pc - last_pc));
+    putVarint(zigzag(ea - last_ea));
+    last_pc = pc;
+    last_ea = ea;
+    gap = 0;
+}
+
+void TraceWriter::close() {
+    if (file == NULL)
+        return;
+    // Trailing runs of non-memory instructions
+    for (uint32_t tid = 0; tid < gaps.size(); tid++) {
+        if (gaps[tid] == 0)
+            continue;
+        if (tid != cur_tid)
+            switchThread(tid);
+        if (buf_len + TRACE_MAX_RECORD > TRACE_BUF_SIZE)
+            flush();
+        buf[buf_len++] = TRACE_CTL_RUN << 2;
+        putVarint(gaps[tid]);
+        gaps[tid] = 0;
+    }
+    flush();
+    // Go back and fill in the totals
+    fseek(file, 0, SEEK_SET);
+    fwrite(&hdr, sizeof(hdr), 1, file);
+    fclose(file);
+    file = NULL;
+    free(buf);
+    buf = NULL;
+}
+
+TraceReader::TraceReader() : base(NULL), size(0), end(NULL) {
+    memset(&hdr, 0, sizeof(hdr));
+    memset(&pos, 0, sizeof(pos));
+}
+
+TraceReader::~TraceReader() {
+    close();
+}
+
+bool TraceReader::open(const char* path) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat sb;
+    if (fstat(fd, &sb) < 0 || (size_t)sb.st_size < sizeof(TraceHeader)) {
+        ::close(fd);
+        return false;
+    }
+    size = sb.st_size;
+    void* m = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (m == MAP_FAILED)
+        return false;
+    madvise(m, size, MADV_SEQUENTIAL);
+    base = (const uint8_t*) m;
+    memcpy(&hdr, base, sizeof(hdr));
+    // Version 1 traces are version 2 traces of a single thread
+    if (memcmp(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic)) != 0 || hdr.version < 1 || hdr.version > TRACE_VERSION) {
+        close();
+        return false;
+    }
+    end = base + size;
+    pos = begin();
+    return true;
+}
+
+void TraceReader::close() {
+    if (base)
+        munmap((void*) base, size);
+    base = NULL;
+    end = NULL;
+    size = 0;
+    memset(&pos, 0, sizeof(pos));
+}
+
+TraceCursor TraceReader::begin() const {
+    TraceCursor c;
+    c.cur = base ? base + sizeof(hdr) : NULL;
+    c.last_pc = 0;
+    c.last_ea = 0;
+    c.tid = 0;
+    return c;
+}
+
+static inline bool get_varint(const uint8_t*& cur, const uint8_t* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; cur < end && shift < 64; shift += 7) {
+        uint8_t b = *cur++;
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return true;
+    }
+    // Truncated trace
+    return false;
+}
+
+bool TraceReader::next(TraceCursor& c, TraceRecord& r) const {
+    uint8_t tag;
+    for (;;) {
+        if (c.cur >= end)
+            return false;
+        tag = *c.cur++;
+        if (tag != TRACE_CTL_THREAD << 2)
+            break;
+        uint64_t tid;
+        if (!get_varint(c.cur, end, tid))
+            return false;
+        c.tid = (uint32_t) tid;
+    }
+    uint8_t kind = tag & 3;
+    r.ld = kind & 1;
+    r.st = (kind & 2) != 0;
+    r.nonmem = tag >> 2;
+    r.tid = c.tid;
+    if (kind == 0 || r.nonmem == TRACE_GAP_ESCAPE) {
+        if (!get_varint(c.cur, end, r.nonmem))
+            return false;
+    }
+    if (kind == 0) {
+        r.pc = 0;
+        r.ea = 0;
+        return true;
+    }
+    uint64_t dpc, dea;
+    if (!get_varint(c.cur, end, dpc) || !get_varint(c.cur, end, dea))
+        return false;
+    c.last_pc += unzigzag(dpc);
+    c.last_ea += unzigzag(dea);
+    r.pc = c.last_pc;
+    r.ea = c.last_ea;
+    return true;
+}
+
+bool trace_is_binary(const char* path) {
+    char magic[8];
+    FILE* f = fopen(path, "rb");
+    if (f == NULL)
+        return false;
+    size_t n = fread(magic, 1, sizeof(magic), f);
+    fclose(f);
+    return n == sizeof(magic) && memcmp(magic, TRACE_MAGIC, sizeof(magic)) == 0;
+}
@@ -0,0 +1,138 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <vector>
+
+// Compact binary instruction trace
+//
+// The file starts with a TraceHeader followed by a stream of records. Each
+// record describes one memory instruction and the run of non-memory
+// instructions that came before it:
+//
+//     tag byte  [gap varint]  pc delta varint  ea delta varint
+//
+// The low 2 bits of the tag are the kind (bit 0 = load, bit 1 = store) and
+// the upper 6 bits hold the number of preceding non-memory instructions. A
+// value of 63 means the count follows as a separate varint. PCs and EAs are
+// zigzag encoded deltas from the previous memory instruction. A tag with kind
+// 0 is a control record and its upper bits say which one:
+//
+//     0  a run of non-memory instructions with no memory instruction after
+//        it (written when a thread ends); the count follows as a varint
+//     1  thread switch: the following records belong to the thread whose id
+//        follows as a varint (version 2)
+//
+// Records start out on thread 0. Each thread's non-memory instructions are
+// folded into that thread's next record, so only the order within a thread
+// is kept. Non-memory PCs are not recorded since the simulator never looks at
+// them.
+
+#define TRACE_MAGIC "MDTRACE"
+#define TRACE_VERSION 2
+
+struct TraceHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t instructions;  // Total instructions, filled in when the writer is closed
+    uint64_t mem_ops;       // Total memory instructions
+};
+
+struct TraceRecord {
+    uint64_t nonmem;    // Non-memory instructions before this one
+    uint64_t pc;
+    uint64_t ea;
+    bool ld;
+    bool st;            // A record with neither ld nor st only carries nonmem
+    uint32_t tid;       // Guest thread
+};
+
+// Size of one instruction stored without encoding (PC, EA and a flags byte),
+// used to report compression ratios
+static const size_t TRACE_RAW_RECORD_SIZE = 17;
+
+class TraceWriter {
+public:
+    TraceWriter();
+    ~TraceWriter();
+
+    bool open(const char* path);
+    // Appends one dynamic instruction of thread 0
+    void write(uint64_t pc, bool st, bool ld, uint64_t ea) { write(0, pc, st, ld, ea); }
+    // Appends one dynamic instruction of a thread. Not thread safe.
+    void write(uint32_t tid, uint64_t pc, bool st, bool ld, uint64_t ea);
+    // Appends a run of n non-memory instructions of a thread
+    void writeNonMem(uint32_t tid, uint64_t n);
+    // Flushes the pending runs and fills in the header totals
+    void close();
+
+    uint64_t instructions() const { return hdr.instructions; }
+    uint64_t bytesWritten() const { return bytes; }
+
+private:
+    TraceWriter(const TraceWriter&);
+    TraceWriter& operator=(const TraceWriter&);
+
+    void flush();
+    void putVarint(uint64_t v);
+    void switchThread(uint32_t tid);
+
+    FILE* file;
+    TraceHeader hdr;
+    uint8_t* buf;
+    size_t buf_len;
+    uint64_t bytes;
+    std::vector<uint64_t> gaps;     // Pending non-memory run of each thread
+    uint32_t cur_tid;
+    uint64_t last_pc;
+    uint64_t last_ea;
+};
+
+// Decoding position in a trace. Several cursors can walk the same
+// TraceReader mapping, e.g. one per thread.
+struct TraceCursor {
+    const uint8_t* cur;
+    uint64_t last_pc;
+    uint64_t last_ea;
+    uint32_t tid;
+};
+
+// Reads a binary trace straight out of a read-only memory mapping
+class TraceReader {
+public:
+    TraceReader();
+    ~TraceReader();
+
+    bool open(const char* path);
+    void close();
+
+    // Decodes the next record. Returns false at the end of the trace.
+    bool next(TraceRecord& r) { return next(pos, r); }
+    // Same, from an independent cursor
+    bool next(TraceCursor& c, TraceRecord& r) const;
+    // Cursor at the first record
+    TraceCursor begin() const;
+
+    // Header totals (0 if the writer was never closed)
+    uint64_t instructions() const { return hdr.instructions; }
+    uint64_t memOps() const { return hdr.mem_ops; }
+    size_t fileSize() const { return size; }
+
+private:
+    TraceReader(const TraceReader&);
+    TraceReader& operator=(const TraceReader&);
+
+    TraceHeader hdr;
+    const uint8_t* base;
+    size_t size;
+    const uint8_t* end;
+    TraceCursor pos;
+};
+
+// Returns true if path starts with the binary trace magic
+bool trace_is_binary(const char* path);
+
+#endif
@@ -0,0 +1,101 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <chrono>
+
+#include "trace.h"
+
+using namespace std;
+
+static volatile uint64_t sink;
+
+// Prints the size, compression ratio and decode throughput of a binary trace,
+// or converts a text trace (<pc> <L|S|-> <ea> [tid] per line) into a binary one.
+
+static void usage(const char* prog) {
+    cerr << "usage: " << prog << " <trace>" << endl;
+    cerr << "       " << prog << " -c <text trace> <binary trace>" << endl;
+}
+
+static int convert(const char* in_name, const char* out_name) {
+    FILE* in = fopen(in_name, "r");
+    if (in == NULL) {
+        cerr << "cannot open " << in_name << endl;
+        return EXIT_FAILURE;
+    }
+    TraceWriter writer;
+    if (!writer.open(out_name)) {
+        cerr << "cannot open " << out_name << endl;
+        fclose(in);
+        return EXIT_FAILURE;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), in)) {
+        unsigned long long pc, ea;
+        char kind;
+        unsigned tid = 0;
+        if (sscanf(line, "%llx %c %llx %u", &pc, &kind, &ea, &tid) < 3)
+            continue;
+        writer.write(tid, pc, kind == 'S', kind == 'L', ea);
+    }
+    fclose(in);
+    writer.close();
+    cout << "Wrote " << writer.instructions() << " instructions in "
+         << writer.bytesWritten() << " bytes" << endl;
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv) {
+    using namespace std::chrono;
+
+    if (argc == 4 && strcmp(argv[1], "-c") == 0)
+        return convert(argv[2], argv[3]);
+    if (argc != 2) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    TraceReader reader;
+    if (!reader.open(argv[1])) {
+        cerr << argv[1] << " is not a binary trace" << endl;
+        return EXIT_FAILURE;
+    }
+
+    // Decode the whole trace, touching every field so nothing is optimized out
+    uint64_t instructions = 0, loads = 0, stores = 0, records = 0, check = 0;
+    uint32_t max_tid = 0;
+    TraceRecord r;
+    high_resolution_clock::time_point t1 = high_resolution_clock::now();
+    while (reader.next(r)) {
+        records++;
+        instructions += r.nonmem;
+        if (r.ld || r.st)
+            instructions++;
+        loads += r.ld;
+        stores += r.st;
+        check ^= r.pc ^ r.ea;
+        if (r.tid > max_tid)
+            max_tid = r.tid;
+    }
+    high_resolution_clock::time_point t2 = high_resolution_clock::now();
+    double secs = duration_cast<duration<double>>(t2 - t1).count();
+    sink = check;
+
+    double raw = (double) instructions * TRACE_RAW_RECORD_SIZE;
+    cout << "Instructions: " << instructions << endl;
+    cout << "Loads: " << loads << endl;
+    cout << "Stores: " << stores << endl;
+    cout << "Records: " << records << endl;
+    cout << "Threads: " << max_tid + 1 << endl;
+    cout << "File Size (bytes): " << reader.fileSize() << endl;
+    cout << "Bytes per Instruction: " << (double) reader.fileSize() / (double) instructions << endl;
+    cout << "Compression Ratio (vs " << TRACE_RAW_RECORD_SIZE << " B/ins raw): "
+         << raw / (double) reader.fileSize() << endl;
+    cout << "Decode Time (s): " << secs << endl;
+    cout << "Decode Throughput (M ins/s): " << (double) instructions / secs / 1e6 << endl;
+    cout << "Decode Throughput (MB/s): " << (double) reader.fileSize() / secs / 1e6 << endl;
+    if (reader.instructions() != 0 && reader.instructions() != instructions)
+        cerr << "warning: header records " << reader.instructions() << " instructions" << endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,103 @@
+#include "tracesim.h"
+#include "live.h"
+#include <string.h>
+
+// Records handed to the simulator per virtual call
+#define TRACESIM_BATCH 1024
+
+TraceSims::TraceSims(const MDSimConfig& cfg, MDLiveStats* live, uint32_t sim)
+    : cfg(cfg), live(live), sim(sim) {
+}
+
+TraceSims::~TraceSims() {
+    for (std::map<uint32_t, MDSim*>::iterator i = sims.begin(); i != sims.end(); ++i)
+        delete i->second;
+}
+
+MDSim* TraceSims::thread(uint32_t tid) {
+    std::map<uint32_t, MDSim*>::iterator i = sims.find(tid);
+    if (i != sims.end())
+        return i->second;
+    MDSim* s = mdsim_create(cfg);
+    if (live)
+        s->setLive(live->addSlot(tid, sim, s->config()));
+    sims[tid] = s;
+    return s;
+}
+
+void TraceSims::resetStats() {
+    for (std::map<uint32_t, MDSim*>::iterator i = sims.begin(); i != sims.end(); ++i)
+        i->second->resetStats();
+}
+
+MDSimStats TraceSims::stats() const {
+    MDSimStats st;
+    memset(&st, 0, sizeof(st));
+    for (std::map<uint32_t, MDSim*>::const_iterator i = sims.begin(); i != sims.end(); ++i)
+        mdsim_stats_add(st, i->second->stats());
+    return st;
+}
+
+MDSimConfig TraceSims::config() {
+    return thread(sims.empty() ? 0 : sims.begin()->first)->config();
+}
+
+TracePos tracesim_begin(const TraceReader& reader) {
+    TracePos pos;
+    memset(&pos, 0, sizeof(pos));
+    pos.c = reader.begin();
+    return pos;
+}
+
+uint64_t tracesim_run(const TraceReader& reader, TracePos& pos, uint64_t n, TraceSims* sims) {
+    MDSimRecord batch[TRACESIM_BATCH];
+    size_t count = 0;
+    uint64_t done = 0;
+    // A batch holds records of one thread
+    MDSim* sim = NULL;
+    uint32_t tid = 0;
+    while (done < n) {
+        if (pos.left_nonmem == 0 && !pos.left_mem) {
+            if (!reader.next(pos.c, pos.r))
+                break;
+            pos.left_nonmem = pos.r.nonmem;
+            pos.left_mem = pos.r.ld || pos.r.st;
+            continue;
+        }
+        if (sims && (sim == NULL || pos.r.tid != tid)) {
+            if (count > 0)
+                sim->stepBatch(batch, count);
+            count = 0;
+            tid = pos.r.tid;
+            sim = sims->thread(tid);
+        }
+        MDSimRecord& b = batch[count];
+        if (pos.left_nonmem + (pos.left_mem ? 1 : 0) <= n - done) {
+            // The rest of the record fits
+            b.nonmem = pos.left_nonmem;
+            b.pc = pos.r.pc;
+            b.ea = pos.r.ea;
+            b.ld = pos.left_mem && pos.r.ld;
+            b.st = pos.left_mem && pos.r.st;
+            done += pos.left_nonmem + (pos.left_mem ? 1 : 0);
+            pos.left_nonmem = 0;
+            pos.left_mem = false;
+        }
+        else {
+            // Stop inside the non-memory run
+            b.nonmem = n - done;
+            b.ld = false;
+            b.st = false;
+            pos.left_nonmem -= n - done;
+            done = n;
+        }
+        if (++count == TRACESIM_BATCH) {
+            if (sim)
+                sim->stepBatch(batch, count);
+            count = 0;
+        }
+    }
+    if (sim && count > 0)
+        sim->stepBatch(batch, count);
+    return done;
+}
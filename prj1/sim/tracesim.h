@@ -0,0 +1,57 @@
+#ifndef _TRACESIM_H_
+#define _TRACESIM_H_
+
+#include <map>
+
+#include "mdsim.h"
+#include "trace.h"
+
+class MDLiveStats;
+
+// Drives simulators from a binary trace, with positions at any instruction
+// (a run of non-memory instructions can be split between two calls). Every
+// guest thread gets its own simulator, as in replay and the pintool.
+
+// The simulators of the threads of a trace for one configuration, created
+// when a thread first runs
+class TraceSims {
+public:
+    // With live, each new simulator publishes to a slot of thread tid and
+    // simulator number sim
+    TraceSims(const MDSimConfig& cfg, MDLiveStats* live = NULL, uint32_t sim = 0);
+    ~TraceSims();
+
+    MDSim* thread(uint32_t tid);
+    void resetStats();
+    // Counters summed over the threads
+    MDSimStats stats() const;
+    // Configuration as the simulators resolved it
+    MDSimConfig config();
+
+private:
+    TraceSims(const TraceSims&);
+    TraceSims& operator=(const TraceSims&);
+
+    MDSimConfig cfg;
+    MDLiveStats* live;
+    uint32_t sim;
+    std::map<uint32_t, MDSim*> sims;
+};
+
+struct TracePos {
+    TraceCursor c;
+    TraceRecord r;          // Record under the cursor
+    uint64_t left_nonmem;   // Non-memory instructions of r not simulated yet
+    bool left_mem;          // Memory instruction of r not simulated yet
+};
+
+// Position of the first instruction of the trace
+TracePos tracesim_begin(const TraceReader& reader);
+
+// Simulates up to n instructions from pos and advances it, each on the
+// simulator of its thread. With NULL sims the instructions are only skipped.
+// Returns the number of instructions consumed, which is less than n at the
+// end of the trace.
+uint64_t tracesim_run(const TraceReader& reader, TracePos& pos, uint64_t n, TraceSims* sims);
+
+#endif